@@ -9,9 +9,6 @@ uniform vec2 blackHoleCenter;   // Center of the black hole in quad UV space
 uniform float eventHorizon;     // Radius of the event horizon
 uniform float lensingRadius;    // Radius of the lensing effect
 uniform float maxDistortion;    // Maximum distortion
-uniform mat4 model;             // Model matrix for the quad
-uniform mat4 view;              // View matrix for the camera
-uniform mat4 projection;        // Projection matrix
 
 void main()
 {
@@ -5,8 +5,12 @@ layout(location = 1) in vec2 aTexCoords;
 
 out vec2 texCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+
 uniform mat4 model;
 
 void main()
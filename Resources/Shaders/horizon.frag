@@ -0,0 +1,30 @@
+#version 330 core
+
+in vec3 WorldPos;
+in vec3 Normal;
+
+uniform vec4 chunkHole; // Centre x, z and half extent of the loaded chunks, w is 1 if they're a circle
+uniform vec4 levelHole; // Min x, z and max x, z of the finer level
+
+out vec4 FragColor;
+
+void main()
+{
+    vec2 d = abs(WorldPos.xz - chunkHole.xy) / chunkHole.z;
+    float holeDistance = chunkHole.w > 0.5f ? length(d) : max(d.x, d.y);
+    if (holeDistance < 1.0f)
+        discard;
+
+    if (all(greaterThanEqual(WorldPos.xz, levelHole.xy)) && all(lessThan(WorldPos.xz, levelHole.zw)))
+        discard;
+
+    // Grass on the flat, stone on the slopes
+    vec3 grass = vec3(0.36f, 0.55f, 0.24f);
+    vec3 stone = vec3(0.5f, 0.5f, 0.5f);
+    vec3 color = mix(grass, stone, smoothstep(0.15f, 0.4f, 1.0f - Normal.y));
+
+    // Same lighting as the chunks
+    float light = clamp((Normal.y + 1.0f) / 2.0f, 0.0f, 1.0f);
+
+    FragColor = vec4(color * light, 1.0f);
+}
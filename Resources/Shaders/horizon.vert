@@ -0,0 +1,43 @@
+#version 330 core
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+
+// The horizon reaches well past the Camera block's far plane
+uniform mat4 horizonProjection;
+
+uniform sampler2DArray heights;
+uniform int level;
+uniform int gridSize;
+uniform ivec2 origin;      // First sample of the level, in samples
+uniform ivec2 texelOrigin; // Where that sample is in the wrapped layer
+uniform float spacing;     // Blocks between samples
+
+out vec3 WorldPos;
+out vec3 Normal;
+
+// Grid coordinates are never negative, so the wrap doesn't need a signed modulo
+float getHeight(ivec2 grid) {
+    ivec2 texel = (texelOrigin + grid) % gridSize;
+    return texelFetch(heights, ivec3(texel, level), 0).r;
+}
+
+void main()
+{
+    ivec2 grid = ivec2(gl_VertexID % gridSize, gl_VertexID / gridSize);
+    float height = getHeight(grid);
+
+    // Central differences, one-sided at the edges
+    ivec2 lo = max(grid - 1, ivec2(0));
+    ivec2 hi = min(grid + 1, ivec2(gridSize - 1));
+    float dx = (getHeight(ivec2(hi.x, grid.y)) - getHeight(ivec2(lo.x, grid.y))) / (float(hi.x - lo.x) * spacing);
+    float dz = (getHeight(ivec2(grid.x, hi.y)) - getHeight(ivec2(grid.x, lo.y))) / (float(hi.y - lo.y) * spacing);
+    Normal = normalize(vec3(-dx, 1.0f, -dz));
+
+    vec2 xz = vec2(origin + grid) * spacing;
+    WorldPos = vec3(xz.x, height, xz.y);
+    gl_Position = horizonProjection * view * vec4(WorldPos, 1.0f);
+}
@@ -1,12 +1,19 @@
 #version 330 core
 
-layout (location = 0) in uint aData1;
-layout (location = 1) in uint aData2;
-//layout (location = 2) in vec3 aNorm;
+// Packed by VertexPacking
+layout (location = 0) in uint aData;
+// Block position of the chunk's origin, one per draw
+layout (location = 2) in ivec3 aChunkOffset;
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Edge length of a chunk in blocks, the packed positions depend on it
+uniform int chunkSize;
 
 out vec2 TexCoord;
 out float Light;
@@ -31,31 +38,54 @@ struct Data
   vec3 norm;
 };
 
+// Same table as VertexData::GetTableNormal
+const vec3 axisNormals[6] = vec3[6](
+    vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f),
+    vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f),
+    vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f)
+);
+
+vec3 getNormal(int index)
+{
+    if (index < 6)
+        return axisNormals[index];
+
+    // 7x7 slopes facing up, then the same facing down, without the flat one at 24
+    int slope = (index - 6) % 48;
+    if (slope >= 24)
+        slope++;
+    float y = index < 54 ? 1.0f : -1.0f;
+    return normalize(vec3(float(slope / 7) / 3.0f - 1.0f, y, float(slope % 7) / 3.0f - 1.0f));
+}
+
 Data getData()
 {
-    float x = ((aData1 >> 24) & 0xFFu) / 8.0f;
-    float y = ((aData1 >> 16) & 0xFFu) / 8.0f;
-    float z = ((aData1 >> 8) & 0xFFu) / 8.0f;
-    
-    float u = ((aData1 >> 4) & 0xFu) / 8.0f;
-    float v = (aData1 & 0xFu) / 8.0f;
+    uint side = uint(chunkSize) + 1u;
+    uint position = aData >> 13;
+    uint attributes = aData & 0x1FFFu;
 
-    int textureIndex = int(aData2 & 0xFFFFFu);
+    float x = float(position % side);
+    float y = float(position / (side * side)) / 8.0f;
+    float z = float(position / side % side);
+
+    int normalIndex = int(attributes % 102u);
+    attributes /= 102u;
+    int textureIndex = int(attributes % 4u);
+    attributes /= 4u;
+
+    float u = float(attributes % 2u);
+    float v = float(attributes / 2u) / 8.0f;
     
     vec2 coords = getTextureCoords(textureIndex, 2, 16, 32, u, v);
 
-    float nX = ((aData2 >> 28) & 0xFu) / 7.5f - 1.0f;
-    float nY = ((aData2 >> 24) & 0xFu) / 7.5f - 1.0f;
-    float nZ = ((aData2 >> 20) & 0xFu) / 7.5f - 1.0f;
-
-    return Data(vec3(x, y, z), coords, normalize(vec3(nX, nY, nZ)));
+    return Data(vec3(x, y, z), coords, getNormal(normalIndex));
 }
 
 void main()
 {
     Data data = getData();
 
-    gl_Position = projection * view * model * vec4(data.pos, 1.0f);
+    gl_Position = projection * view * model * vec4(data.pos + vec3(aChunkOffset), 1.0f);
     TexCoord = data.tex;
 
     float l = dot((model * vec4(data.norm, 1.0f)).xyz, vec3(0.0f, 1.0f, 0.0f));
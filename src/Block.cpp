@@ -1,19 +1,11 @@
 #include "Block.h"
 
+#include <algorithm>
+#include <cmath>
+
 Block::Block() : type(BlockType::AIR), edgeData() {}
 Block::Block(BlockType t) : type(t), edgeData() {}
 
-Block::Block(const Block& other) : type(other.type), edgeData(other.edgeData) {}
-
-Block& Block::operator=(const Block& other) {
-    if (this != &other) {
-        type = other.type;
-        edgeData = other.edgeData;
-        // Copy other properties as needed
-    }
-    return *this;
-}
-
 enum class Face {
     Right = 0,
     Left = 1,
@@ -23,6 +15,54 @@ enum class Face {
     Front = 5
 };
 
+static const glm::vec3 kAxisNormals[6] = {
+    glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0),
+    glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+    glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+};
+
+int VertexData::GetNormalIndex(glm::vec3 normal) {
+    float ax = std::abs(normal.x), ay = std::abs(normal.y), az = std::abs(normal.z);
+
+    if (ay >= ax && ay >= az && ay > 0.0f) {
+        const float half = (SLOPE_STEPS - 1) / 2.0f;
+        int a = static_cast<int>(std::round((normal.x / ay + 1.0f) * half));
+        int b = static_cast<int>(std::round((normal.z / ay + 1.0f) * half));
+        a = std::min(std::max(a, 0), SLOPE_STEPS - 1);
+        b = std::min(std::max(b, 0), SLOPE_STEPS - 1);
+
+        // Flat ones use the axis entries so they decode exactly
+        const int flat = SLOPE_STEPS * SLOPE_STEPS / 2;
+        int slope = a * SLOPE_STEPS + b;
+        if (slope == flat)
+            return normal.y > 0.0f ? 2 : 3;
+        return 6 + (normal.y > 0.0f ? 0 : SLOPES) + (slope > flat ? slope - 1 : slope);
+    }
+
+    // Sides, and the NaN of degenerate triangles which end up here too
+    if (ax >= az)
+        return normal.x > 0.0f ? 0 : 1;
+    return normal.z > 0.0f ? 4 : 5;
+}
+
+glm::vec3 VertexData::GetTableNormal(int index) {
+    if (index < 0 || index >= NORMAL_COUNT)
+        return kAxisNormals[2];
+    if (index < 6)
+        return kAxisNormals[index];
+
+    // Slopes past the flat one are shifted down by one
+    const int flat = SLOPE_STEPS * SLOPE_STEPS / 2;
+    int slope = (index - 6) % SLOPES;
+    if (slope >= flat)
+        slope++;
+    float y = index - 6 < SLOPES ? 1.0f : -1.0f;
+    const float half = (SLOPE_STEPS - 1) / 2.0f;
+    float a = (slope / SLOPE_STEPS) / half - 1.0f;
+    float b = (slope % SLOPE_STEPS) / half - 1.0f;
+    return glm::normalize(glm::vec3(a, y, b));
+}
+
 glm::vec3 GetNormal(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3) {
     glm::vec3 A = p3 - p1;
     glm::vec3 B = p2 - p1;
@@ -193,13 +233,13 @@ std::array<VertexData, 6> GetFaceVertices(Face face, const EdgeData& edgeData, i
     return vertices;
 }
 
-void Block::AddFaceVertices(std::vector<uint32_t>& vertices, int face, int x, int y, int z) const {
-    auto faceVertices = GetFaceVertices(static_cast<Face>(face), edgeData, x, y, z, blockTextureMap[type]);
+void Block::AddFaceVertices(std::vector<uint32_t>& vertices, int face, int x, int y, int z, int scale) const {
+    auto faceVertices = GetFaceVertices(static_cast<Face>(face), edgeData, 0, 0, 0, blockTextureMap[type]);
 
     for (size_t i = 0; i < 6; i++)
     {
-        vertices.push_back(faceVertices[i].GetVertexInt());
-        vertices.push_back(faceVertices[i].GetVertexNormInt());
+        faceVertices[i].pos = faceVertices[i].pos * (float)scale + glm::vec3(x, y, z);
+        vertices.push_back(VertexPacking<ChunkDimensions::SIZE>::Pack(faceVertices[i]));
     }
 }
 
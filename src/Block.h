@@ -6,6 +6,8 @@
 #include <array>
 #include <glm/glm.hpp>
 
+#include "ChunkLayout.h"
+
 struct EdgeData {
     uint8_t edges[4];
 
@@ -74,33 +76,64 @@ struct VertexData {
     VertexData() : pos(glm::vec3(0, 0, 0)), tex(glm::vec2(0, 0)), textureIndex(0), norm(glm::vec3(0, 0, 0)) {}
     VertexData(glm::vec3 pos, glm::vec2 tex, int textureIndex, glm::vec3 norm) : pos(pos), tex(tex), textureIndex(textureIndex), norm(norm) {}
 
-    uint32_t GetVertexInt() {
-        uint32_t x = this->pos.x * 8;
-        uint32_t y = this->pos.y * 8;
-        uint32_t z = this->pos.z * 8;
-        uint32_t u = this->tex.x * 8;
-        uint32_t v = this->tex.y * 8;
-        uint32_t result = 0;
-        result |= (x & 0xFFu) << 24;
-        result |= (y & 0xFFu) << 16;
-        result |= (z & 0xFFu) << 8;
-        result |= (u & 0xFu) << 4;
-        result |= v & 0xFu;
-        
-        return result;
+    static const int TEXTURE_COUNT = 4;
+    // Six axis normals, then 7x7 slopes facing up and the same facing down. The flat
+    // slope in the middle of each grid is left out, it's the axis normal.
+    static const int SLOPE_STEPS = 7;
+    static const int SLOPES = SLOPE_STEPS * SLOPE_STEPS - 1;
+    static const int NORMAL_COUNT = 6 + 2 * SLOPES;
+
+    // Nearest table entry. Sloped tops and bottoms have normals of the form
+    // (a, +-1, b) with a and b within [-1, 1], which are kept in thirds. Every
+    // entry maps back to its own index.
+    static int GetNormalIndex(glm::vec3 normal);
+    static glm::vec3 GetTableNormal(int index);
+};
+
+// Chunk vertices packed into one uint32 for the vertex buffers, main.vert decodes it.
+// Faces only ever have corners on whole x and z, heights are what come in eighths,
+// so a chunk of Size blocks has (Size + 1)^2 * (8 * Size + 1) corner positions.
+// Those are counted in the top bits and everything else in the low ATTRIBUTE_BITS:
+//   position    x + (Size + 1) * (z + (Size + 1) * y8)
+//   attributes  normal + NORMAL_COUNT * (texture + TEXTURE_COUNT * (u + 2 * v8))
+// with y8 and v8 in eighths, u either 0 or 1 and normal an index into the table above.
+template <int ChunkSize>
+struct VertexPacking
+{
+    static constexpr uint32_t SIDE = ChunkSize + 1;
+    static constexpr uint32_t HEIGHTS = 8 * ChunkSize + 1;
+    static constexpr int ATTRIBUTE_BITS = 13;
+    static constexpr uint32_t ATTRIBUTE_MASK = (1u << ATTRIBUTE_BITS) - 1;
+
+    static_assert(VertexData::NORMAL_COUNT * VertexData::TEXTURE_COUNT * 2 * 9 <= (1 << ATTRIBUTE_BITS), "Attributes don't fit");
+    static_assert((uint64_t)SIDE * SIDE * HEIGHTS <= (1ull << (32 - ATTRIBUTE_BITS)), "Chunk too large for packed vertices");
+
+    static uint32_t Pack(const VertexData& vertex) {
+        uint32_t x = static_cast<uint32_t>(vertex.pos.x + 0.5f);
+        uint32_t y = static_cast<uint32_t>(vertex.pos.y * 8 + 0.5f);
+        uint32_t z = static_cast<uint32_t>(vertex.pos.z + 0.5f);
+        uint32_t u = static_cast<uint32_t>(vertex.tex.x + 0.5f);
+        uint32_t v = static_cast<uint32_t>(vertex.tex.y * 8 + 0.5f);
+        uint32_t texture = static_cast<uint32_t>(vertex.textureIndex) % VertexData::TEXTURE_COUNT;
+
+        uint32_t position = x + SIDE * (z + SIDE * y);
+        uint32_t attributes = VertexData::GetNormalIndex(vertex.norm) + VertexData::NORMAL_COUNT * (texture + VertexData::TEXTURE_COUNT * (u + 2 * v));
+        return (position << ATTRIBUTE_BITS) | attributes;
     }
 
-    uint32_t GetVertexNormInt() {
-        uint32_t normX = (this->norm.x + 1.0f) * 7.5f;
-        uint32_t normY = (this->norm.y + 1.0f) * 7.5f;
-        uint32_t normZ = (this->norm.z + 1.0f) * 7.5f;
-        uint32_t result = 0;
-        result |= (normX & 0xFu) << 28;
-        result |= (normY & 0xFu) << 24;
-        result |= (normZ & 0xFu) << 20;
-        result |= textureIndex & 0xFFFFFu;
-
-        return result;
+    // The normal comes back as the table entry it was packed to
+    static VertexData Unpack(uint32_t packed) {
+        uint32_t position = packed >> ATTRIBUTE_BITS;
+        uint32_t attributes = packed & ATTRIBUTE_MASK;
+
+        glm::vec3 pos(static_cast<float>(position % SIDE), static_cast<float>(position / (SIDE * SIDE)) / 8.0f,
+            static_cast<float>(position / SIDE % SIDE));
+        int normal = static_cast<int>(attributes % VertexData::NORMAL_COUNT);
+        attributes /= VertexData::NORMAL_COUNT;
+        int texture = static_cast<int>(attributes % VertexData::TEXTURE_COUNT);
+        attributes /= VertexData::TEXTURE_COUNT;
+        glm::vec2 tex(static_cast<float>(attributes % 2), static_cast<float>(attributes / 2) / 8.0f);
+        return VertexData(pos, tex, texture, VertexData::GetTableNormal(normal));
     }
 };
 
@@ -134,16 +167,31 @@ public:
     Block();
     Block(BlockType t);
 
-    // Copy constructor
-    Block(const Block& other);
-
-    // Assignment operator
-    Block& operator=(const Block& other);
+    // Trivially copyable, so blocks can be copied as bytes and used straight from a mapped file
+    Block(const Block& other) = default;
+    Block& operator=(const Block& other) = default;
 
-    void AddFaceVertices(std::vector<uint32_t>& vertices, int face, int x, int y, int z) const;
+    // scale stretches the block over that many blocks from x, y, z, for LOD meshes
+    void AddFaceVertices(std::vector<uint32_t>& vertices, int face, int x, int y, int z, int scale = 1) const;
     void Shrink();
     void SetEdgeData(EdgeData edgeData);
 
     bool IsFullBlock() const;
 };
 
+// How many blocks of a volume are solid and how many of those are full cubes
+struct BlockOccupancy {
+    int solidCount = 0;
+    int fullCount = 0;
+
+    void Add(const Block& block, int count = 1) {
+        if (block.type == BlockType::AIR) return;
+        solidCount += count;
+        if (block.IsFullBlock()) fullCount += count;
+    }
+
+    void Remove(const Block& block, int count = 1) {
+        Add(block, -count);
+    }
+};
+
@@ -0,0 +1,164 @@
+#include "BufferAllocator.h"
+
+#include <iterator>
+
+BufferAllocator::BufferAllocator(uint32_t capacity) {
+    Reset(capacity);
+}
+
+void BufferAllocator::Reset(uint32_t capacity) {
+    this->capacity = capacity;
+    allocatedUnits = 0;
+    allocations.clear();
+    freeRanges.clear();
+    for (auto& sizeClass : classes)
+        sizeClass.clear();
+    nonEmptyClasses = 0;
+
+    if (capacity > 0)
+        InsertFree(0, capacity);
+}
+
+int BufferAllocator::SizeClass(uint32_t size) {
+    int sizeClass = 0;
+    while (size >>= 1)
+        sizeClass++;
+    return sizeClass;
+}
+
+uint32_t BufferAllocator::Allocate(uint32_t size) {
+    if (size == 0)
+        return INVALID_OFFSET;
+
+    // Best fit among the ranges of the same class
+    int sizeClass = SizeClass(size);
+    auto fit = classes[sizeClass].lower_bound(std::make_pair(size, 0u));
+    if (fit != classes[sizeClass].end())
+        return TakeFrom(freeRanges.find(fit->second), size);
+
+    // Every range in a larger class fits, the smallest class wastes the least
+    uint32_t larger = sizeClass + 1 < CLASS_COUNT ? nonEmptyClasses & ~((2u << sizeClass) - 1) : 0;
+    if (larger == 0)
+        return INVALID_OFFSET;
+
+    int largerClass = 0;
+    while (!(larger & (1u << largerClass)))
+        largerClass++;
+    return TakeFrom(freeRanges.find(classes[largerClass].begin()->second), size);
+}
+
+void BufferAllocator::Free(uint32_t offset) {
+    auto allocation = allocations.find(offset);
+    if (allocation == allocations.end())
+        return;
+
+    uint32_t size = allocation->second;
+    allocations.erase(allocation);
+    allocatedUnits -= size;
+
+    // Merge with the free ranges on either side
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        auto merged = next++;
+        EraseFree(merged);
+    }
+    if (next != freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            EraseFree(previous);
+        }
+    }
+    InsertFree(offset, size);
+}
+
+std::vector<BufferAllocator::Move> BufferAllocator::Defragment(uint32_t maxUnits) {
+    std::vector<Move> moves;
+    if (freeRanges.empty())
+        return moves;
+
+    // Collected first since moving changes the allocations
+    std::vector<std::pair<uint32_t, uint32_t>> candidates(allocations.rbegin(), allocations.rend());
+
+    uint32_t moved = 0;
+    for (const auto& candidate : candidates) {
+        uint32_t offset = candidate.first, size = candidate.second;
+
+        // Everything before this allocation is already packed
+        if (freeRanges.empty() || freeRanges.begin()->first > offset)
+            break;
+
+        // Lowest free range in front of it that fits, it ends before the allocation starts
+        auto range = freeRanges.begin();
+        while (range != freeRanges.end() && range->first < offset && range->second < size)
+            ++range;
+        if (range == freeRanges.end() || range->first > offset)
+            continue;
+
+        uint32_t destination = TakeFrom(range, size);
+        Free(offset);
+        moves.push_back(Move{ offset, destination, size });
+
+        moved += size;
+        if (moved >= maxUnits)
+            break;
+    }
+
+    return moves;
+}
+
+uint32_t BufferAllocator::GetSize(uint32_t offset) const {
+    auto allocation = allocations.find(offset);
+    return allocation != allocations.end() ? allocation->second : 0;
+}
+
+BufferAllocator::Stats BufferAllocator::GetStats() const {
+    Stats stats;
+    stats.capacity = capacity;
+    stats.allocatedUnits = allocatedUnits;
+    stats.allocationCount = (uint32_t)allocations.size();
+    stats.freeRangeCount = (uint32_t)freeRanges.size();
+
+    stats.largestFreeRange = 0;
+    for (int sizeClass = CLASS_COUNT - 1; sizeClass >= 0; sizeClass--) {
+        if (!classes[sizeClass].empty()) {
+            stats.largestFreeRange = classes[sizeClass].rbegin()->first;
+            break;
+        }
+    }
+
+    uint32_t freeUnits = capacity - allocatedUnits;
+    stats.fragmentation = freeUnits > 0 ? 1.0f - (float)stats.largestFreeRange / freeUnits : 0.0f;
+    return stats;
+}
+
+void BufferAllocator::InsertFree(uint32_t offset, uint32_t size) {
+    int sizeClass = SizeClass(size);
+    freeRanges[offset] = size;
+    classes[sizeClass].insert(std::make_pair(size, offset));
+    nonEmptyClasses |= 1u << sizeClass;
+}
+
+void BufferAllocator::EraseFree(std::map<uint32_t, uint32_t>::iterator range) {
+    int sizeClass = SizeClass(range->second);
+    classes[sizeClass].erase(std::make_pair(range->second, range->first));
+    if (classes[sizeClass].empty())
+        nonEmptyClasses &= ~(1u << sizeClass);
+    freeRanges.erase(range);
+}
+
+uint32_t BufferAllocator::TakeFrom(std::map<uint32_t, uint32_t>::iterator range, uint32_t size) {
+    uint32_t offset = range->first;
+    uint32_t remaining = range->second - size;
+    EraseFree(range);
+
+    // The rest can't have a free neighbour, the range it came from didn't
+    if (remaining > 0)
+        InsertFree(offset + size, remaining);
+
+    allocations[offset] = size;
+    allocatedUnits += size;
+    return offset;
+}
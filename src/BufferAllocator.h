@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Bookkeeping for ranges inside one fixed size buffer, in whatever unit the caller
+// uses. Free ranges are kept in size classes of powers of two with a bit per
+// non-empty class, so an allocation checks its own class for the best fit and
+// otherwise takes from the smallest larger class in constant time. Freed ranges
+// merge with free neighbours.
+//
+// Nothing here touches the buffer itself, Defragment only says which ranges to
+// copy where.
+class BufferAllocator
+{
+public:
+    static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+    struct Stats {
+        uint32_t capacity;
+        uint32_t allocatedUnits;
+        uint32_t allocationCount;
+        uint32_t freeRangeCount;
+        uint32_t largestFreeRange;
+        // Share of the free space outside the largest free range, 0 when it's all in one piece
+        float fragmentation;
+    };
+
+    struct Move {
+        uint32_t from, to, size;
+    };
+
+    BufferAllocator(uint32_t capacity = 0);
+
+    // Empties the allocator and sets its size
+    void Reset(uint32_t capacity);
+
+    // INVALID_OFFSET when no free range is big enough
+    uint32_t Allocate(uint32_t size);
+    void Free(uint32_t offset);
+
+    // Moves allocations from the end of the buffer into free ranges closer to its
+    // start, until about maxUnits have been moved. Source and destination never
+    // overlap, so the moves can be copied in any order.
+    std::vector<Move> Defragment(uint32_t maxUnits);
+
+    uint32_t GetCapacity() const { return capacity; }
+    uint32_t GetAllocatedUnits() const { return allocatedUnits; }
+    bool IsEmpty() const { return allocations.empty(); }
+    // Size of the allocation at offset, 0 if there isn't one
+    uint32_t GetSize(uint32_t offset) const;
+    Stats GetStats() const;
+
+private:
+    static const int CLASS_COUNT = 32;
+
+    uint32_t capacity = 0;
+    uint32_t allocatedUnits = 0;
+
+    std::map<uint32_t, uint32_t> allocations; // Offset to size
+    std::map<uint32_t, uint32_t> freeRanges;  // Offset to size, never adjacent
+    // Free ranges by size class, each ordered by size then offset
+    std::set<std::pair<uint32_t, uint32_t>> classes[CLASS_COUNT];
+    uint32_t nonEmptyClasses = 0;
+
+    static int SizeClass(uint32_t size);
+    void InsertFree(uint32_t offset, uint32_t size);
+    void EraseFree(std::map<uint32_t, uint32_t>::iterator range);
+    // Takes size units from the start of a free range
+    uint32_t TakeFrom(std::map<uint32_t, uint32_t>::iterator range, uint32_t size);
+};
@@ -34,6 +34,7 @@ void Camera::UpdateLook(double xPos, double yPos) {
 
 void Camera::UpdateMove(GLFWwindow* window, double deltaTime) {
     float cameraSpeed = 10.0f * (float)deltaTime;
+    glm::vec3 previousPos = cameraPos;
 
     if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
         cameraSpeed *= 2;
@@ -50,6 +51,9 @@ void Camera::UpdateMove(GLFWwindow* window, double deltaTime) {
         Camera::cameraPos -= Camera::cameraUp * cameraSpeed;
     if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
         Camera::cameraPos += Camera::cameraUp * cameraSpeed;
+
+    if (deltaTime > 0.0)
+        velocity = (cameraPos - previousPos) / (float)deltaTime;
 }
 
 glm::mat4 Camera::GetViewMatrix() const {
@@ -57,7 +61,11 @@ glm::mat4 Camera::GetViewMatrix() const {
 }
 
 glm::mat4 Camera::GetProjectionMatrix(float frameWidth, float frameHeight) const {
-    return glm::perspective(glm::radians(45.0f), frameWidth / frameHeight, 0.1f, 1000.0f);
+    return GetProjectionMatrix(frameWidth, frameHeight, 0.1f, 1000.0f);
+}
+
+glm::mat4 Camera::GetProjectionMatrix(float frameWidth, float frameHeight, float nearPlane, float farPlane) const {
+    return glm::perspective(glm::radians(45.0f), frameWidth / frameHeight, nearPlane, farPlane);
 }
 
 glm::vec3 Camera::GetPosition() {
@@ -68,6 +76,10 @@ glm::vec3 Camera::GetDirection() {
     return cameraFront;
 }
 
+glm::vec3 Camera::GetVelocity() const {
+    return velocity;
+}
+
 glm::vec2 Camera::GetDirectionAngles() const
 {
     return glm::vec2(pitch, yaw);
@@ -13,13 +13,17 @@ public:
 	void UpdateMove(GLFWwindow* window, double deltaTime);
 	glm::mat4 GetViewMatrix() const;
 	glm::mat4 GetProjectionMatrix(float frameWidth, float frameHeight) const;
+	glm::mat4 GetProjectionMatrix(float frameWidth, float frameHeight, float nearPlane, float farPlane) const;
 	glm::vec3 GetPosition();
 	glm::vec3 GetDirection();
+	// Blocks per second over the last UpdateMove
+	glm::vec3 GetVelocity() const;
 	glm::vec2 GetDirectionAngles() const;
 private:
 	glm::vec3 cameraPos = glm::vec3(7.0f, 7.0f, 7.0f);
 	glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 	glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::vec3 velocity = glm::vec3(0.0f);
 	double lastX = 400, lastY = 300;
 	float pitch = 0.0f, yaw = -90.0f;
 };
@@ -0,0 +1,21 @@
+#include "CameraUniforms.h"
+#include "Shader.h"
+
+CameraUniforms::CameraUniforms() {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, Shader::CAMERA_BLOCK_BINDING, buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+CameraUniforms::~CameraUniforms() {
+    glDeleteBuffers(1, &buffer);
+}
+
+void CameraUniforms::Update(const glm::mat4& view, const glm::mat4& projection) {
+    Block block = { view, projection };
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
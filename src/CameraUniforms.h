@@ -0,0 +1,30 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+// The Camera uniform block every shader shares, uploaded once per frame instead
+// of setting view and projection on each program:
+//
+//     layout (std140) uniform Camera { mat4 view; mat4 projection; };
+//
+// Shader binds the block to Shader::CAMERA_BLOCK_BINDING after linking. Has to
+// be created and updated on the render thread.
+class CameraUniforms
+{
+public:
+    CameraUniforms();
+    ~CameraUniforms();
+    CameraUniforms(const CameraUniforms&) = delete;
+    CameraUniforms& operator=(const CameraUniforms&) = delete;
+
+    void Update(const glm::mat4& view, const glm::mat4& projection);
+
+private:
+    // Matches the std140 layout, two mat4s need no padding
+    struct Block {
+        glm::mat4 view;
+        glm::mat4 projection;
+    };
+
+    GLuint buffer = 0;
+};
@@ -1,15 +1,21 @@
 #include "Chunk.h"
-#include "Shader.h"
+#include "WorldGenerator.h"
 #include "World.h"
+#include <algorithm>
 #include <iostream>
+#include <thread>
+#include <type_traits>
 
 //Chunk::Chunk() : world(0), chunkX(0), chunkY(0), chunkZ(0), isGenerated(false) {}
 
 Chunk::Chunk(World* world, int chunkX, int chunkY, int chunkZ)
     : world(world), chunkX(chunkX), chunkY(chunkY), chunkZ(chunkZ),
-    isSetup(false), isLoaded(false), isInitialized(false), isMeshSent(false),
-    VAO(0), VBO(0), isEmpty(false), isFull(false), isSurrounded(false),
+    isSetup(false), isLoaded(false), isMeshSent(false),
+    isEmpty(false), isFull(false), isSurrounded(false),
     needsRebuilding(false) {
+    blockArrays.push_back(std::make_shared<BlockArray>());
+    liveBlocks = blockArrays[0]->data();
+    blockArrayCount = 1;
     chunkCount++;
 }
 
@@ -18,49 +24,66 @@ Chunk::~Chunk() {
     chunkCount--;
 }
 
-Chunk::Chunk(const Chunk& other) : blocks(), world(other.world),
-chunkX(other.chunkX), chunkY(other.chunkY), chunkZ(other.chunkZ), VAO(other.VAO), VBO(other.VBO), isEmpty(other.isEmpty), 
-isFull(other.isFull), isSurrounded(other.isSurrounded) {}
+Chunk::Chunk(const Chunk& other) : blockArrays{ std::make_shared<BlockArray>() }, mappedBlocks(other.mappedBlocks.load()), world(other.world),
+chunkX(other.chunkX), chunkY(other.chunkY), chunkZ(other.chunkZ), isEmpty(other.isEmpty), 
+isFull(other.isFull), isSurrounded(other.isSurrounded) {
+    liveBlocks = blockArrays[0]->data();
+    blockArrayCount = 1;
+}
 
 Chunk& Chunk::operator=(const Chunk& other) {
     if (this != &other) {
-        blocks = other.blocks;
+        BlockWrite write(*this);
+        const Block* source = other.ReadBlocks();
+        std::copy(source, source + CHUNK_VOLUME, WritableBlocks(false));
+        mappedBlocks = other.mappedBlocks.load();
+        occupancy = other.occupancy;
         world = other.world;
         chunkX = other.chunkX;
         chunkY = other.chunkY;
         chunkZ = other.chunkZ;
-        VAO = other.VAO;
-        VBO = other.VBO;
     }
     return *this;
 }
 
-Chunk::Chunk(Chunk&& other) noexcept : blocks(std::move(other.blocks)),
-world(other.world), chunkX(other.chunkX), chunkY(other.chunkY), chunkZ(other.chunkZ), VAO(other.VAO), VBO(other.VBO), 
+Chunk::Chunk(Chunk&& other) noexcept : blockArrays(std::move(other.blockArrays)), liveArray(other.liveArray), liveBlocks(other.liveBlocks.load()),
+blockArrayCount(other.blockArrayCount.load()), mappedBlocks(other.mappedBlocks.load()), occupancy(other.occupancy),
+world(other.world), chunkX(other.chunkX), chunkY(other.chunkY), chunkZ(other.chunkZ), 
 isEmpty(other.isEmpty), isFull(other.isFull), isSurrounded(other.isSurrounded) {}
 
 Chunk& Chunk::operator=(Chunk&& other) noexcept {
     if (this != &other) {
-        blocks = std::move(other.blocks);
+        blockArrays = std::move(other.blockArrays);
+        liveArray = other.liveArray;
+        liveBlocks = other.liveBlocks.load();
+        blockArrayCount = other.blockArrayCount.load();
+        mappedBlocks = other.mappedBlocks.load();
+        occupancy = other.occupancy;
         world = std::move(other.world);
         chunkX = std::move(other.chunkX);
         chunkY = std::move(other.chunkY);
         chunkZ = std::move(other.chunkZ);
-        VAO = std::move(other.VAO);
-        VBO = std::move(other.VBO);
     }
     return *this;
 }
 
 void Chunk::Reset(int chunkX, int chunkY, int chunkZ) {
-    std::lock_guard<std::mutex> lock(block_mutex);
+    BlockWrite write(*this);
 
-    // Clear all block data
-    blocks.fill(Block(BlockType::AIR));
+    // Block data is left as is, LoadChunk overwrites all of it
+    hasBlockData = false;
+    needsSaving = false;
+    mappedBlocks = nullptr;
+    hasBakedMesh = false;
+    occupancy = BlockOccupancy();
 
     // Clear mesh data
     vertices.clear();
+    faceRanges.fill(0);
+    lodLevel = 0;
+    meshLodLevel = 0;
     vertex_count = 0;
+    meshBytes = vertices.capacity() * sizeof(uint32_t);
 
     // Reset all flags
     isLoaded = false;
@@ -70,84 +93,206 @@ void Chunk::Reset(int chunkX, int chunkY, int chunkZ) {
     isEmpty = false;
     isFull = false;
     isSurrounded = false;
+    isUniform = false;
 
     // Set new coordinates
     this->chunkX = chunkX;
     this->chunkY = chunkY;
     this->chunkZ = chunkZ;
+    neighborCacheEpoch = EpochReclaimer::NO_EPOCH;
 
     // Don't reset OpenGL buffers here - they'll be reused
     // Just mark that mesh needs to be sent again
 }
 
-void Chunk::LoadChunk(TerrainGenerator* terrainGenerator) {
-    std::lock_guard<std::mutex> lock(block_mutex);
-    blocks.fill(Block(BlockType::AIR));
+bool Chunk::RestoreChunk() {
+    if (!hasBlockData)
+        return false;
+
+    // Neighbours may have been recycled while this chunk was unloaded
+    neighborCacheEpoch = EpochReclaimer::NO_EPOCH;
+    isSetup = false;
+    isLoaded = true;
+    return true;
+}
+
+bool Chunk::ReleaseMesh() {
+    if (isGeneratingMesh)
+        return false;
+
+    Clear();
+    vertices.shrink_to_fit();
+    vertex_count = 0;
+    meshBytes = 0;
+    isMeshSent = false;
+    hasBakedMesh = false;
+    return true;
+}
 
-    float heights[CHUNK_SIZE + 1][CHUNK_SIZE + 1];
+void Chunk::LoadChunk(WorldGenerator& generator) {
+    BlockWrite write(*this);
+    occupancy = generator.FillChunk(chunkX, chunkY, chunkZ, WritableBlocks(false));
+    hasBakedMesh = false;
+    isEmpty = occupancy.fullCount == 0;
+    isFull = occupancy.fullCount == CHUNK_VOLUME;
+    isUniform = false;
+    needsSaving = false;
 
-    for (int x = 0; x < CHUNK_SIZE + 1; x++) {
-        for (int z = 0; z < CHUNK_SIZE + 1; z++) {
-            int blockX = chunkX * CHUNK_SIZE + x;
-            int blockZ = chunkZ * CHUNK_SIZE + z;
-            heights[x][z] = terrainGenerator->GetHeight(blockX, blockZ);
+    hasBlockData = true;
+    isLoaded = true;
+}
+
+void Chunk::LoadSavedChunk(const Block* savedBlocks, const BlockOccupancy& savedOccupancy) {
+    BlockWrite write(*this);
+    std::copy(savedBlocks, savedBlocks + CHUNK_VOLUME, WritableBlocks(false));
+    hasBakedMesh = false;
+    occupancy = savedOccupancy;
+    isEmpty = occupancy.fullCount == 0;
+    isFull = occupancy.fullCount == CHUNK_VOLUME;
+    isUniform = false;
+    needsSaving = false;
+
+    hasBlockData = true;
+    isLoaded = true;
+}
+
+void Chunk::LoadMappedChunk(const Block* mapped, const BlockOccupancy& mappedOccupancy, const uint32_t* mesh, size_t meshSize,
+    const ChunkDrawList::FaceRanges& meshRanges) {
+    BlockWrite write(*this);
+    mappedBlocks = mapped;
+    occupancy = mappedOccupancy;
+    isEmpty = occupancy.fullCount == 0;
+    isFull = occupancy.fullCount == CHUNK_VOLUME;
+    isUniform = false;
+    needsSaving = false;
+
+    if (mesh && !isGeneratingMesh) {
+        vertices.assign(mesh, mesh + meshSize);
+        faceRanges = meshRanges;
+        vertex_count = vertices.size();
+        meshBytes = vertices.capacity() * sizeof(uint32_t);
+        hasVisibleFaces = meshSize > 0;
+        isMeshSent = false;
+        hasBakedMesh = true;
+    }
+    else {
+        hasBakedMesh = false;
+    }
+
+    hasBlockData = true;
+    isLoaded = true;
+}
+
+bool Chunk::CopyForSnapshot(std::vector<Block>& outBlocks, BlockOccupancy& outOccupancy, std::vector<uint32_t>* outMesh,
+    ChunkDrawList::FaceRanges* outMeshRanges) {
+    std::lock_guard<std::mutex> lock(block_mutex);
+    if (!hasBlockData)
+        return false;
+
+    const Block* source = ReadBlocks();
+    outBlocks.assign(source, source + CHUNK_VOLUME);
+    outOccupancy = occupancy;
+
+    if (outMesh && outMeshRanges) {
+        outMesh->clear();
+        outMeshRanges->fill(0);
+        if (isSetup && !needsRebuilding && !isGeneratingMesh && meshLodLevel == 0) {
+            *outMesh = vertices;
+            *outMeshRanges = faceRanges;
         }
     }
+    return true;
+}
 
-    for (int x = 0; x < CHUNK_SIZE; x++)
-    {
-        for (int z = 0; z < CHUNK_SIZE; z++)
-        {
-            const float smoothness = 8.0f;
-
-            float worldHeight1 = round(heights[x][z + 1] * smoothness) / smoothness;
-            float worldHeight2 = round(heights[x + 1][z] * smoothness) / smoothness;
-            float worldHeight3 = round(heights[x][z] * smoothness) / smoothness;
-            float worldHeight4 = round(heights[x + 1][z + 1] * smoothness) / smoothness;
-
-            float minHeight1 = worldHeight1 < worldHeight2 ? worldHeight1 : worldHeight2;
-            float minHeight2 = worldHeight3 < worldHeight4 ? worldHeight3 : worldHeight4;
-            int minHeight = static_cast<int>(floor(minHeight1 < minHeight2 ? minHeight1 : minHeight2));
-
-            for (int y = 0; y < CHUNK_SIZE; y++)
-            {
-                int blockY = chunkY * CHUNK_SIZE + y;
-
-                float fWorldHeight1 = worldHeight1 - blockY;
-                float fWorldHeight2 = worldHeight2 - blockY;
-                float fWorldHeight3 = worldHeight3 - blockY;
-                float fWorldHeight4 = worldHeight4 - blockY;
-
-                int blockHeight1 = static_cast<int>(fWorldHeight1 * 8);
-                int blockHeight2 = static_cast<int>(fWorldHeight2 * 8);
-                int blockHeight3 = static_cast<int>(fWorldHeight3 * 8);
-                int blockHeight4 = static_cast<int>(fWorldHeight4 * 8);
-
-                if (blockY == minHeight) {
-                    EdgeData edges = EdgeData();
-                    edges.SetTopY(0, blockHeight1);
-                    edges.SetTopY(1, blockHeight2);
-                    edges.SetTopY(2, blockHeight3);
-                    edges.SetTopY(3, blockHeight4);
-
-                    if (edges.IsValid()) {
-                        SetBlock(x, y, z, BlockType::GRASS, edges);
-                    }
-                    else {
-                        if (y > 0) // Workaround so it doesn't set a block at a negative y
-                            SetBlock(x, y - 1, z, BlockType::GRASS);
-                    }
-                }
-                else if (blockY < minHeight && blockY > minHeight - 5) {
-                    SetBlock(x, y, z, BlockType::DIRT);
-                }
-                else if (blockY < minHeight) {
-                    SetBlock(x, y, z, BlockType::STONE);
-                }
-            }
+bool Chunk::SnapshotBlocks(BlockSnapshot& out) {
+    std::lock_guard<std::mutex> lock(block_mutex);
+    if (!hasBlockData)
+        return false;
+
+    const Block* mapped = mappedBlocks;
+    out.storage = mapped ? nullptr : blockArrays[liveArray];
+    out.blocks = mapped ? mapped : out.storage->data();
+    out.occupancy = occupancy;
+    out.version = blockVersion.load(std::memory_order_relaxed);
+    return true;
+}
+
+bool Chunk::SnapshotForSave(BlockSnapshot& out) {
+    std::lock_guard<std::mutex> lock(block_mutex);
+    if (!hasBlockData || !needsSaving)
+        return false;
+
+    // Edits copy mapped blocks in, so this only shares the current array
+    const Block* mapped = mappedBlocks;
+    if (mapped) {
+        auto copy = std::make_shared<BlockArray>();
+        std::copy(mapped, mapped + CHUNK_VOLUME, copy->begin());
+        out.storage = copy;
+    }
+    else {
+        out.storage = blockArrays[liveArray];
+    }
+    out.blocks = out.storage->data();
+    out.occupancy = occupancy;
+    out.version = blockVersion.load(std::memory_order_relaxed);
+    needsSaving = false;
+    return true;
+}
+
+void Chunk::ReleaseSpareBlocks() {
+    std::lock_guard<std::mutex> lock(block_mutex);
+    // Arrays a snapshot still holds live on with it
+    std::shared_ptr<BlockArray> live = std::move(blockArrays[liveArray]);
+    blockArrays.clear();
+    blockArrays.push_back(std::move(live));
+    liveArray = 0;
+    blockArrayCount = 1;
+}
+
+const Block* Chunk::ReadBlocks() const {
+    const Block* mapped = mappedBlocks;
+    return mapped ? mapped : liveBlocks.load();
+}
+
+Block* Chunk::WritableBlocks(bool keepContents) {
+    const Block* current = ReadBlocks();
+
+    if (blockArrays[liveArray].use_count() > 1) {
+        // Snapshots only take a reference under block_mutex, which the writer holds,
+        // so a count of one can't go back up until the write is done
+        size_t spare = 0;
+        while (spare < blockArrays.size() && (spare == liveArray || blockArrays[spare].use_count() > 1))
+            spare++;
+        if (spare == blockArrays.size()) {
+            blockArrays.push_back(std::make_shared<BlockArray>());
+            blockArrayCount = blockArrays.size();
         }
+        liveArray = spare;
     }
+    // Whoever let go of the array last may have been reading it on another thread
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    Block* target = blockArrays[liveArray]->data();
+    if (keepContents && current != target)
+        std::copy(current, current + CHUNK_VOLUME, target);
+    liveBlocks = target;
+    mappedBlocks = nullptr;
+    return target;
+}
 
+void Chunk::LoadUniform(BlockType type) {
+    BlockWrite write(*this);
+    Block* target = WritableBlocks(false);
+    std::fill(target, target + CHUNK_VOLUME, Block(type));
+    hasBakedMesh = false;
+    occupancy = BlockOccupancy();
+    occupancy.Add(Block(type), CHUNK_VOLUME);
+
+    isEmpty = type == BlockType::AIR;
+    isFull = !isEmpty;
+    isUniform = true;
+    needsSaving = false;
+    hasBlockData = true;
     isLoaded = true;
 }
 
@@ -163,13 +308,47 @@ void Chunk::UnloadChunk()
     isLoaded = false;
 }
 
-int Chunk::Index(int x, int y, int z) const {
-    return x + CHUNK_SIZE * (y + CHUNK_SIZE * z);
+Chunk::BlockWrite::BlockWrite(Chunk& chunk) : chunk(chunk), lock(chunk.block_mutex) {
+    // Only writers change the version and they hold the lock, so no read-modify-write is needed
+    chunk.blockVersion.store(chunk.blockVersion.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
 }
 
-const Block& Chunk::GetBlock(int x, int y, int z) {
-    std::lock_guard<std::mutex> lock(block_mutex);
-    return blocks[Index(x, y, z)];
+Chunk::BlockWrite::~BlockWrite() {
+    chunk.blockVersion.store(chunk.blockVersion.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+uint32_t Chunk::BeginBlockRead() const {
+    uint32_t version = blockVersion.load(std::memory_order_acquire);
+    while (version & 1) {
+        std::this_thread::yield();
+        version = blockVersion.load(std::memory_order_acquire);
+    }
+    return version;
+}
+
+bool Chunk::EndBlockRead(uint32_t version) const {
+    // Keeps the reads before it from moving past the version check
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return blockVersion.load(std::memory_order_relaxed) == version;
+}
+
+BlockOccupancy Chunk::ReadOccupancy() const {
+    for (;;) {
+        uint32_t version = BeginBlockRead();
+        BlockOccupancy counts = occupancy;
+        if (EndBlockRead(version))
+            return counts;
+    }
+}
+
+Block Chunk::GetBlock(int x, int y, int z) const {
+    for (;;) {
+        uint32_t version = BeginBlockRead();
+        Block block = ReadBlocks()[Index(x, y, z)];
+        if (EndBlockRead(version))
+            return block;
+    }
 }
 
 bool Chunk::ShouldRender()
@@ -177,6 +356,11 @@ bool Chunk::ShouldRender()
     return vertex_count > 0;
 }
 
+size_t Chunk::GetMemoryUsage() const
+{
+    return sizeof(Chunk) + blockArrayCount * sizeof(BlockArray) + meshBytes + gpuMeshBytes;
+}
+
 bool Chunk::IsLoaded() const
 {
     return isLoaded;
@@ -219,27 +403,9 @@ void Chunk::SetNeedsRebuilding(bool value)
 
 void Chunk::UpdateEmptyFullFlags()
 {
-    isEmpty = true;
-    isFull = true;
-
-    for (int x = 0; x < CHUNK_SIZE; x++)
-    {
-        for (int y = 0; y < CHUNK_SIZE; y++)
-        {
-            for (int z = 0; z < CHUNK_SIZE; z++)
-            {
-                auto& block = GetBlock(x, y, z);
-                if (block.IsFullBlock()) {
-                    isEmpty = false;
-                }
-                else {
-                    isFull = false;
-                }
-
-                if (!isEmpty && !isFull) return; // Since we know it's not full and not empty we don't need to check the rest of the blocks
-            }
-        }
-    }
+    BlockOccupancy counts = ReadOccupancy();
+    isEmpty = counts.fullCount == 0;
+    isFull = counts.fullCount == CHUNK_VOLUME;
 }
 
 void Chunk::UpdateChunkSurroundedFlag() {
@@ -266,49 +432,77 @@ glm::ivec3 Chunk::GetCoords()
     return glm::ivec3(chunkX, chunkY, chunkZ);
 }
 
-bool Chunk::GetBlockCulls(int x, int y, int z)
+bool Chunk::GetBlockCulls(int x, int y, int z) const
 {
-    std::lock_guard<std::mutex> lock(block_mutex);
-    Block b = blocks[Index(x, y, z)];
-
-    return b.IsFullBlock();
+    return GetBlock(x, y, z).IsFullBlock();
 }
 
 void Chunk::SetBlock(int x, int y, int z, Block block)
 {
-    //std::lock_guard<std::mutex> lock(block_mutex);
-    blocks[Index(x, y, z)] = block;
+    BlockWrite write(*this);
+    Block& target = WritableBlocks(true)[Index(x, y, z)];
+    occupancy.Remove(target);
+    target = block;
+    occupancy.Add(target);
+    isUniform = false;
+    needsSaving = true;
 }
 
 void Chunk::SetBlock(int x, int y, int z, BlockType type) {
-    //std::lock_guard<std::mutex> lock(block_mutex);
-    blocks[Index(x, y, z)].type = type;
-    blocks[Index(x, y, z)].edgeData.MakeFull();
+    BlockWrite write(*this);
+    Block& target = WritableBlocks(true)[Index(x, y, z)];
+    occupancy.Remove(target);
+    target.type = type;
+    target.edgeData.MakeFull();
+    occupancy.Add(target);
+    isUniform = false;
+    needsSaving = true;
 }
 
 void Chunk::SetBlock(int x, int y, int z, EdgeData edges) {
-    //std::lock_guard<std::mutex> lock(block_mutex);
-    blocks[Index(x, y, z)].SetEdgeData(edges);
+    BlockWrite write(*this);
+    Block& target = WritableBlocks(true)[Index(x, y, z)];
+    occupancy.Remove(target);
+    target.SetEdgeData(edges);
+    occupancy.Add(target);
+    isUniform = false;
+    needsSaving = true;
 }
 
 void Chunk::SetBlock(int x, int y, int z, BlockType type, EdgeData edges) {
-    //std::lock_guard<std::mutex> lock(block_mutex);
-    blocks[Index(x, y, z)].type = type;
-    blocks[Index(x, y, z)].SetEdgeData(edges);
+    BlockWrite write(*this);
+    Block& target = WritableBlocks(true)[Index(x, y, z)];
+    occupancy.Remove(target);
+    target.type = type;
+    target.SetEdgeData(edges);
+    occupancy.Add(target);
+    isUniform = false;
+    needsSaving = true;
 }
 
-void Chunk::InitializeMeshBuffers() {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-	isInitialized = true;
+void Chunk::SetBlocks(const std::vector<std::tuple<int, int, int, Block>>& edits) {
+    BlockWrite write(*this);
+    Block* target = WritableBlocks(true);
+    for (const auto& edit : edits) {
+        Block& block = target[Index(std::get<0>(edit), std::get<1>(edit), std::get<2>(edit))];
+        occupancy.Remove(block);
+        block = std::get<3>(edit);
+        occupancy.Add(block);
+    }
+    isUniform = false;
+    needsSaving = true;
 }
 
 void Chunk::Clear() {
     vertices.clear();
-
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    isInitialized = false;
+    faceRanges.fill(0);
+    gpuMeshBytes = 0;
+
+    if (meshArena)
+        meshArena->Free(meshAllocation);
+    meshArena = nullptr;
+    uploadedVertexCount = 0;
+    uploadedFaceRanges.fill(0);
 }
 
 const int kFaceNeighborOffsets[6][3] = {
@@ -320,6 +514,18 @@ const int kFaceNeighborOffsets[6][3] = {
     { 0,  0, -1},  // Front face
 };
 
+// Which face range of the mesh a face goes in. Tops and bottoms are only flat,
+// and face straight up or down, if all four corners are at the same height.
+static int FaceRange(const Block& block, int face) {
+    const EdgeData& edges = block.edgeData;
+    for (int i = 1; i < 4; i++) {
+        if ((face == 2 && edges.GetTopY(i) != edges.GetTopY(0)) ||
+            (face == 3 && edges.GetBottomY(i) != edges.GetBottomY(0)))
+            return ChunkDrawList::SLOPED_FACE_RANGE;
+    }
+    return face;
+}
+
 
 void Chunk::GenerateMesh() {
     // Early exit if already generating
@@ -327,75 +533,233 @@ void Chunk::GenerateMesh() {
         return; // Another thread is already generating this mesh
     }
 
-    // Quick check for empty chunks
-    bool hasBlocks = false;
-    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE; ++i) {
-        if (blocks[i].type != BlockType::AIR) {
-            hasBlocks = true;
-            break;
-        }
-    }
+    // Meshed from a snapshot, an edit landing in the meantime leaves the chunk
+    // needing another rebuild instead of getting in the way
+    BlockSnapshot snapshot;
+    bool hasBlocks = SnapshotBlocks(snapshot) && snapshot.occupancy.solidCount > 0;
 
+    // Quick check for empty chunks
     if (!hasBlocks) {
         vertices.clear();
+        faceRanges.fill(0);
         vertex_count = 0;
-        needsRebuilding = false;
+        meshBytes = vertices.capacity() * sizeof(uint32_t);
+        needsRebuilding = snapshot.blocks && !IsSnapshotCurrent(snapshot);
         isMeshSent = false;
         hasVisibleFaces = false;
+        hasBakedMesh = false;
+        meshLodLevel = lodLevel.load();
         isGeneratingMesh = false;
         return;
     }
 
     // Cache neighbor chunks if needed
-    if (!neighborCacheValid) {
+    uint64_t chunkEpoch = world->GetChunkEpoch();
+    if (neighborCacheEpoch != chunkEpoch) {
         cachedNeighbors[0] = world->GetChunk(chunkX + 1, chunkY, chunkZ);
         cachedNeighbors[1] = world->GetChunk(chunkX - 1, chunkY, chunkZ);
         cachedNeighbors[2] = world->GetChunk(chunkX, chunkY + 1, chunkZ);
         cachedNeighbors[3] = world->GetChunk(chunkX, chunkY - 1, chunkZ);
         cachedNeighbors[4] = world->GetChunk(chunkX, chunkY, chunkZ + 1);
         cachedNeighbors[5] = world->GetChunk(chunkX, chunkY, chunkZ - 1);
-        neighborCacheValid = true;
+        neighborCacheEpoch = chunkEpoch;
     }
 
-    std::vector<uint32_t> new_vertices;
-    new_vertices.reserve(vertices.size() > 0 ? vertices.size() : 1024); // Reserve space
+    int lod = lodLevel;
 
+    // All the mesh needs from a neighbour is which blocks of the layer touching
+    // this chunk are full cubes. Missing neighbours hide nothing.
+    LayerCulls borderCulls[6] = {};
+    for (int face = 0; face < 6; ++face) {
+        Chunk* neighborChunk = cachedNeighbors[face];
+        if (neighborChunk && neighborChunk->IsLoaded()) {
+            int axis = face / 2;
+            neighborChunk->GetLayerCulls(axis, kFaceNeighborOffsets[face][axis] > 0 ? 0 : CHUNK_SIZE - 1, borderCulls[face]);
+        }
+    }
+
+    static_assert(std::has_unique_object_representations<Block>::value, "Blocks are hashed as bytes, they can't have padding");
+    MeshCache& meshCache = world->GetMeshCache();
+
+    // Faces are collected per range and joined at the end, kept around so
+    // their capacity carries over between meshes
+    thread_local std::vector<uint32_t> rangeVertices[ChunkDrawList::FACE_RANGE_COUNT];
+
+    const Block* source = snapshot.blocks;
+
+    // Those, the blocks and the level are everything the mesh is built from
+    MeshCache::Hasher hasher;
+    hasher.Add(source, CHUNK_VOLUME * sizeof(Block));
+    hasher.Add(borderCulls, sizeof(borderCulls));
+    hasher.Add(&lod, sizeof(lod));
+    MeshCache::Key key = hasher.Finish();
+    MeshCache::Verifier verifier{ snapshot.occupancy.solidCount, snapshot.occupancy.fullCount, lod };
+
+    if (auto cached = meshCache.Find(key, verifier)) {
+        vertices = cached->vertices;
+        faceRanges = cached->faceRanges;
+        meshLodLevel = lod;
+        vertex_count = vertices.size();
+        meshBytes = vertices.capacity() * sizeof(uint32_t);
+        hasVisibleFaces = !vertices.empty();
+        hasBakedMesh = false;
+        needsRebuilding = !IsSnapshotCurrent(snapshot);
+        isMeshSent = false;
+        isGeneratingMesh = false;
+        return;
+    }
+
+    for (auto& range : rangeVertices)
+        range.clear();
     bool foundVisibleFaces = false;
 
-    // Optimized face checking with early exits
-    for (int x = 0; x < Chunk::CHUNK_SIZE; ++x) {
-        for (int y = 0; y < Chunk::CHUNK_SIZE; ++y) {
-            for (int z = 0; z < Chunk::CHUNK_SIZE; ++z) {
-                const Block& block = blocks[Index(x, y, z)];
-                if (block.type == BlockType::AIR) continue;
+    if (lod > 0) {
+        foundVisibleFaces = AddLodFaces(source, 1 << lod, borderCulls, rangeVertices);
+    }
+    else {
+        // Blocks are visited in memory order, so with the brick and Morton layouts
+        // most neighbour reads land in cache lines the walk just touched
+        ChunkDimensions::ForEachVoxel([&](int x, int y, int z, int index) {
+            const Block& block = source[index];
+            if (block.type == BlockType::AIR) return;
+
+            for (int face = 0; face < 6; ++face) {
+                int neighborX = x + kFaceNeighborOffsets[face][0];
+                int neighborY = y + kFaceNeighborOffsets[face][1];
+                int neighborZ = z + kFaceNeighborOffsets[face][2];
+
+                bool neighborBlockCulls = false;
+
+                if (neighborX >= 0 && neighborX < Chunk::CHUNK_SIZE &&
+                    neighborY >= 0 && neighborY < Chunk::CHUNK_SIZE &&
+                    neighborZ >= 0 && neighborZ < Chunk::CHUNK_SIZE) {
+                    // Internal neighbor - direct access
+                    neighborBlockCulls = source[Index(neighborX, neighborY, neighborZ)].IsFullBlock();
+                }
+                else {
+                    // External neighbor - from the border layers
+                    int coords[3] = { x, y, z };
+                    int axis = face / 2;
+                    neighborBlockCulls = IsLayerCulled(borderCulls[face], coords[(axis + 1) % 3], coords[(axis + 2) % 3]);
+                }
 
-                // Check each face with optimized neighbor lookup
-                for (int face = 0; face < 6; ++face) {
-                    int neighborX = x + kFaceNeighborOffsets[face][0];
-                    int neighborY = y + kFaceNeighborOffsets[face][1];
-                    int neighborZ = z + kFaceNeighborOffsets[face][2];
+                if (!neighborBlockCulls || !block.IsFullBlock()) {
+                    block.AddFaceVertices(rangeVertices[FaceRange(block, face)], face, x, y, z);
+                    foundVisibleFaces = true;
+                }
+            }
+        });
+    }
+
+    size_t totalSize = 0;
+    for (const auto& range : rangeVertices)
+        totalSize += range.size();
+
+    auto mesh = std::make_shared<MeshCache::Mesh>();
+    mesh->verifier = verifier;
+    mesh->vertices.reserve(totalSize);
+    for (int i = 0; i < ChunkDrawList::FACE_RANGE_COUNT; i++) {
+        mesh->vertices.insert(mesh->vertices.end(), rangeVertices[i].begin(), rangeVertices[i].end());
+        mesh->faceRanges[i] = static_cast<uint32_t>(rangeVertices[i].size() / VertexArena::VERTEX_WORDS);
+    }
+
+    vertices = mesh->vertices;
+    faceRanges = mesh->faceRanges;
+    meshCache.Insert(key, std::move(mesh));
+
+    meshLodLevel = lod;
+    vertex_count = vertices.size();
+    meshBytes = vertices.capacity() * sizeof(uint32_t);
+    hasVisibleFaces = foundVisibleFaces;
+    hasBakedMesh = false;
+    needsRebuilding = !IsSnapshotCurrent(snapshot);
+    isMeshSent = false;
+    isGeneratingMesh = false;
+}
+
+bool Chunk::SetLodLevel(int level) {
+    level = std::max(0, std::min(level, MAX_LOD_LEVEL));
+    return lodLevel.exchange(level) != level;
+}
+
+void Chunk::GetLayerCulls(int axis, int layer, LayerCulls& out) const {
+    for (;;) {
+        uint32_t version = BeginBlockRead();
+        const Block* source = ReadBlocks();
+
+        out.fill(0);
+        int block[3];
+        block[axis] = layer;
+        for (int v = 0; v < CHUNK_SIZE; v++) {
+            for (int u = 0; u < CHUNK_SIZE; u++) {
+                block[(axis + 1) % 3] = u;
+                block[(axis + 2) % 3] = v;
+                if (source[Index(block[0], block[1], block[2])].IsFullBlock()) {
+                    int bit = u + CHUNK_SIZE * v;
+                    out[bit / 64] |= 1ull << (bit % 64);
+                }
+            }
+        }
 
-                    bool neighborBlockCulls = false;
+        if (EndBlockRead(version))
+            return;
+    }
+}
 
-                    if (neighborX >= 0 && neighborX < Chunk::CHUNK_SIZE &&
-                        neighborY >= 0 && neighborY < Chunk::CHUNK_SIZE &&
-                        neighborZ >= 0 && neighborZ < Chunk::CHUNK_SIZE) {
-                        // Internal neighbor - direct access
-                        neighborBlockCulls = blocks[Index(neighborX, neighborY, neighborZ)].IsFullBlock();
+bool Chunk::AddLodFaces(const Block* source, int step, const LayerCulls* borderCulls, std::vector<uint32_t>* rangeVertices) {
+    const int cells = CHUNK_SIZE / step;
+
+    // Each cell takes the type of its highest solid layer, so grass stays on top.
+    // Only called with lod > 0, so there are at most (CHUNK_SIZE / 2)^3 cells
+    const int MAX_CELLS = CHUNK_SIZE / 2;
+    std::array<BlockType, MAX_CELLS * MAX_CELLS * MAX_CELLS> cellTypes;
+    for (int cz = 0; cz < cells; cz++) {
+        for (int cy = 0; cy < cells; cy++) {
+            for (int cx = 0; cx < cells; cx++) {
+                BlockType type = BlockType::AIR;
+                for (int y = cy * step + step - 1; y >= cy * step && type == BlockType::AIR; y--) {
+                    for (int z = cz * step; z < cz * step + step && type == BlockType::AIR; z++) {
+                        for (int x = cx * step; x < cx * step + step && type == BlockType::AIR; x++)
+                            type = source[Index(x, y, z)].type;
+                    }
+                }
+                cellTypes[cx + cells * (cy + cells * cz)] = type;
+            }
+        }
+    }
+
+    bool foundVisibleFaces = false;
+    for (int cz = 0; cz < cells; cz++) {
+        for (int cy = 0; cy < cells; cy++) {
+            for (int cx = 0; cx < cells; cx++) {
+                BlockType type = cellTypes[cx + cells * (cy + cells * cz)];
+                if (type == BlockType::AIR) continue;
+
+                for (int face = 0; face < 6; ++face) {
+                    int nx = cx + kFaceNeighborOffsets[face][0];
+                    int ny = cy + kFaceNeighborOffsets[face][1];
+                    int nz = cz + kFaceNeighborOffsets[face][2];
+
+                    bool neighborCulls = false;
+                    if (nx >= 0 && nx < cells && ny >= 0 && ny < cells && nz >= 0 && nz < cells) {
+                        neighborCulls = cellTypes[nx + cells * (ny + cells * nz)] != BlockType::AIR;
                     }
                     else {
-                        // External neighbor - use cached chunks
-                        Chunk* neighborChunk = cachedNeighbors[face];
-                        if (neighborChunk && neighborChunk->IsLoaded()) {
-                            int nx = (neighborX + Chunk::CHUNK_SIZE) % Chunk::CHUNK_SIZE;
-                            int ny = (neighborY + Chunk::CHUNK_SIZE) % Chunk::CHUNK_SIZE;
-                            int nz = (neighborZ + Chunk::CHUNK_SIZE) % Chunk::CHUNK_SIZE;
-                            neighborBlockCulls = neighborChunk->GetBlockCulls(nx, ny, nz);
+                        // Hidden only if every block it would cover in the neighbour is a
+                        // full cube, which is solid at whatever level the neighbour is at
+                        int axis = face / 2;
+                        int cell[3] = { cx, cy, cz };
+                        int u0 = cell[(axis + 1) % 3] * step, v0 = cell[(axis + 2) % 3] * step;
+
+                        neighborCulls = true;
+                        for (int v = v0; v < v0 + step && neighborCulls; v++) {
+                            for (int u = u0; u < u0 + step && neighborCulls; u++)
+                                neighborCulls = IsLayerCulled(borderCulls[face], u, v);
                         }
                     }
 
-                    if (!neighborBlockCulls || !block.IsFullBlock()) {
-                        block.AddFaceVertices(new_vertices, face, x, y, z);
+                    if (!neighborCulls) {
+                        Block(type).AddFaceVertices(rangeVertices[face], face, cx * step, cy * step, cz * step, step);
                         foundVisibleFaces = true;
                     }
                 }
@@ -403,44 +767,34 @@ void Chunk::GenerateMesh() {
         }
     }
 
-    vertices = std::move(new_vertices);
-    vertex_count = vertices.size();
-    hasVisibleFaces = foundVisibleFaces;
-    needsRebuilding = false;
-    isMeshSent = false;
-    isGeneratingMesh = false;
+    return foundVisibleFaces;
 }
 
-void Chunk::Render(Shader& shader) {
+void Chunk::AddToDrawList(VertexArena& arena, ChunkDrawList& drawList, const glm::vec3& cameraPosition) {
     if (!isLoaded || vertex_count == 0)
         return;
 
-    if (!isInitialized) {
-        InitializeMeshBuffers();
-    }
-
     if (!isMeshSent && vertices.size() > 0) {
-        SendVertexData();
+        SendVertexData(arena);
     }
 
-    shader.Use();
-
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertex_count / 2));
+    if (meshAllocation.IsValid()) {
+        uint32_t visibleRanges = ChunkDrawList::VisibleFaceRanges(chunkX * CHUNK_SIZE, chunkY * CHUNK_SIZE, chunkZ * CHUNK_SIZE,
+            CHUNK_SIZE, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+        drawList.AddFaceRanges(meshAllocation.page, meshAllocation.first, uploadedFaceRanges, visibleRanges,
+            chunkX * CHUNK_SIZE, chunkY * CHUNK_SIZE, chunkZ * CHUNK_SIZE);
+    }
 }
 
-void Chunk::SendVertexData() {
+void Chunk::SendVertexData(VertexArena& arena) {
     if (vertices.empty()) return;
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(uint32_t), vertices.data(), GL_STATIC_DRAW);
-
-    glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (void*)0);
-    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (void*)sizeof(uint32_t));
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
+    meshArena = &arena;
+    uploadedVertexCount = static_cast<uint32_t>(vertices.size() / VertexArena::VERTEX_WORDS);
+    uploadedFaceRanges = faceRanges;
+    if (!arena.Upload(meshAllocation, vertices.data(), uploadedVertexCount))
+        return;
+    gpuMeshBytes = (size_t)meshAllocation.capacity * VertexArena::VERTEX_SIZE;
 
     isMeshSent = true;
-}
\ No newline at end of file
+}
@@ -5,23 +5,59 @@
 #include <memory>
 #include <atomic>
 #include <mutex>
+#include <tuple>
 #include <vector>
 
-#include "TerrainGenerator.h"
 #include "Block.h"
+#include "ChunkLayout.h"
+#include "EpochReclaimer.h"
+#include "MeshCache.h"
+#include "VertexArena.h"
 
 class World;
-class Shader;
+class WorldGenerator;
+
+inline int cantor(int a, int b) {
+    return (a + b + 1) * (a + b) / 2 + b;
+}
+
+struct hash_tuple {
+    size_t operator()(const std::tuple<int, int, int>& x) const {
+        return cantor(std::get<0>(x), cantor(std::get<1>(x), std::get<2>(x)));
+    }
+};
 
 class Chunk
 {
 public:
-	// 31 is the max because the shader uses 1 byte for position and 32 * 8 = 256
-	// which is greater than 255, the max 1 byte can store
-	static const int CHUNK_SIZE = 16; 
+	// Picked at configure time, see ChunkLayout.h
+	static const int CHUNK_SIZE = ChunkDimensions::SIZE;
+	static const int CHUNK_VOLUME = ChunkDimensions::VOLUME;
+	// Level 0 is full detail, each level after it meshes cubes twice as large
+	static const int MAX_LOD_LEVEL = 2;
 
 	static int chunkCount;
 
+	// Bit per block of one layer of a chunk, set if the block is a full cube. Indexed
+	// by the two coordinates besides the layer's axis, in x, y, z order after it.
+	using LayerCulls = std::array<uint64_t, CHUNK_SIZE * CHUNK_SIZE / 64>;
+	static bool IsLayerCulled(const LayerCulls& culls, int u, int v) {
+		int bit = u + CHUNK_SIZE * v;
+		return (culls[bit / 64] >> (bit % 64)) & 1;
+	}
+
+	using BlockArray = std::array<Block, CHUNK_VOLUME>;
+
+	// The blocks as they were when it was taken, read from any thread without locking
+	// for as long as it's held. Taking one copies nothing, instead the chunk's next
+	// edit moves it to another array and leaves this one as it is.
+	struct BlockSnapshot {
+		std::shared_ptr<const BlockArray> storage; // Null for blocks in a world snapshot's mapping
+		const Block* blocks = nullptr;
+		BlockOccupancy occupancy;
+		uint32_t version = 0;
+	};
+
 	//Chunk();
 	Chunk(World* world, int chunkX, int chunkY, int chunkZ);
 	~Chunk();
@@ -31,6 +67,8 @@ public:
 	Chunk& operator=(Chunk&& other) noexcept;
 	
 	void Reset(int chunkX, int chunkY, int chunkZ);
+	bool RestoreChunk();
+	bool ReleaseMesh();
 
 	bool IsLoaded() const;
 	bool IsSetup() const;
@@ -39,7 +77,10 @@ public:
 	bool IsEmpty() const;
 	bool IsFull() const;
 	bool IsSurrounded() const;
+	// Loaded as a single block type without running the generator, never needs a mesh until edited
+	bool IsUniform() const { return isUniform; }
 
+	// Derives the flags from the occupancy counts, no scan over the blocks
 	void UpdateEmptyFullFlags();
 	void UpdateChunkSurroundedFlag();
 	void SetIsSurrounded(bool value);
@@ -47,24 +88,62 @@ public:
 
 	bool ShouldRender();
 
+	// Block storage plus the CPU and GPU copies of the mesh
+	size_t GetMemoryUsage() const;
+
 	glm::ivec3 GetCoords();
 
-	const Block& GetBlock(int x, int y, int z);
-	bool GetBlockCulls(int x, int y, int z);
+	// Reads never lock, see blockVersion. They copy the blocks they need and
+	// retry if a write overlapped, so what they return is a consistent view.
+	Block GetBlock(int x, int y, int z) const;
+	bool GetBlockCulls(int x, int y, int z) const;
+	// The layer at the given position along axis, for meshing the chunk next to it
+	void GetLayerCulls(int axis, int layer, LayerCulls& out) const;
 	void SetBlock(int x, int y, int z, Block block);
 	void SetBlock(int x, int y, int z, BlockType type);
 	void SetBlock(int x, int y, int z, EdgeData edges);
 	void SetBlock(int x, int y, int z, BlockType type, EdgeData edges);
+	// Edits at chunk coordinates, seen by readers and snapshots all at once
+	void SetBlocks(const std::vector<std::tuple<int, int, int, Block>>& edits);
+	// False if the chunk has no blocks yet
+	bool SnapshotBlocks(BlockSnapshot& out);
+	// Nothing was written since the snapshot was taken
+	bool IsSnapshotCurrent(const BlockSnapshot& snapshot) const { return blockVersion.load(std::memory_order_acquire) == snapshot.version; }
 
 	bool IsGeneratingMesh() const { return isGeneratingMesh; }
-	void InvalidateNeighborCache() { neighborCacheValid = false; }
-
-	void LoadChunk(TerrainGenerator* terrainGenerator);
+	void InvalidateNeighborCache() { neighborCacheEpoch = EpochReclaimer::NO_EPOCH; }
+
+	void LoadChunk(WorldGenerator& generator);
+	void LoadSavedChunk(const Block* savedBlocks, const BlockOccupancy& savedOccupancy);
+	// Reads the blocks in place from a world snapshot until the first edit copies them
+	// in. A baked mesh is used as is instead of generating one.
+	void LoadMappedChunk(const Block* mapped, const BlockOccupancy& mappedOccupancy, const uint32_t* mesh, size_t meshSize,
+		const ChunkDrawList::FaceRanges& meshRanges);
+	bool IsMapped() const { return mappedBlocks != nullptr; }
+	bool HasBakedMesh() const { return hasBakedMesh; }
+	// Copies the blocks, and the mesh if it's up to date and outMesh is given, for baking a snapshot
+	bool CopyForSnapshot(std::vector<Block>& outBlocks, BlockOccupancy& outOccupancy, std::vector<uint32_t>* outMesh,
+		ChunkDrawList::FaceRanges* outMeshRanges);
+	// Snapshots the blocks if the chunk needs saving and marks it saved, so the
+	// write itself can happen without holding the chunk. storage is never null.
+	bool SnapshotForSave(BlockSnapshot& out);
+	// Frees block arrays left over from snapshots. Only once no other thread can
+	// be reading the chunk, lock-free readers may still be in any of them.
+	void ReleaseSpareBlocks();
+	// Edited since it was loaded or last saved
+	bool NeedsSaving() const { return needsSaving; }
+	void LoadUniform(BlockType type);
 	void SetupChunk();
 	void UnloadChunk();
 	void GenerateMesh();
-	void SendVertexData();
-	void Render(Shader& shader);
+	// Used from the next GenerateMesh on, true if the level changed
+	bool SetLodLevel(int level);
+	int GetLodLevel() const { return lodLevel; }
+	// Uploads the mesh into the arena if it changed and queues the faces that can
+	// be turned towards the camera for drawing
+	void AddToDrawList(VertexArena& arena, ChunkDrawList& drawList, const glm::vec3& cameraPosition);
+
+	static int Index(int x, int y, int z) { return ChunkDimensions::Index(x, y, z); }
 
 	void DebugPrintState() const {
         std::cout << "Chunk (" << chunkX << "," << chunkY << "," << chunkZ << "): "
@@ -79,36 +158,93 @@ public:
     }
 
 private:
-	std::array<Block, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE> blocks;
+	// Every block array the chunk has used, the current one is blockArrays[liveArray]
+	// and the others are held by snapshots or spare. None are freed while the chunk
+	// is in use, so a reader that raced an edit never reads freed memory.
+	std::vector<std::shared_ptr<BlockArray>> blockArrays;
+	size_t liveArray = 0;
+	std::atomic<Block*> liveBlocks{ nullptr }; // The current array's blocks, for readers that don't lock
+	std::atomic<size_t> blockArrayCount{ 0 };
+	// Blocks in a world snapshot's mapping, read instead of liveBlocks until the chunk is edited
+	std::atomic<const Block*> mappedBlocks{ nullptr };
+	std::atomic<bool> hasBakedMesh{ false };
 	std::vector<uint32_t> vertices;
+	ChunkDrawList::FaceRanges faceRanges{}; // How vertices splits up by face direction
+	std::atomic<int> lodLevel{ 0 };
+	std::atomic<int> meshLodLevel{ 0 }; // Level vertices was built at
 	std::atomic<size_t> vertex_count{ 0 };  // Track renderable vertex count
+	std::atomic<size_t> meshBytes{ 0 };     // Capacity of the CPU-side vertices
+	std::atomic<size_t> gpuMeshBytes{ 0 };  // Size of the mesh's range in the vertex arena
 
 	std::atomic<bool> isGeneratingMesh{ false };
 	bool hasVisibleFaces = true; // Cache whether chunk has any visible faces
 
-	// Cache neighbor chunks to avoid repeated lookups
+	// Cache neighbor chunks to avoid repeated lookups. Only good while no chunk has
+	// been retired since the epoch they were looked up in, after that one of them
+	// could be pooled and reused for other coordinates.
 	mutable Chunk* cachedNeighbors[6] = { nullptr };
-	mutable bool neighborCacheValid = false;
+	mutable uint64_t neighborCacheEpoch = EpochReclaimer::NO_EPOCH;
 
+	// Writers to the blocks and occupancy hold this against each other, readers don't take it
 	std::mutex block_mutex;
+	// Seqlock over the blocks, liveBlocks, mappedBlocks and occupancy. Odd while a
+	// write is in progress, bumped again when it's done. A reader waits for an even
+	// version, reads, and keeps what it read only if the version is still the same.
+	// Snapshots are taken under block_mutex, so no write is in progress then.
+	std::atomic<uint32_t> blockVersion{ 0 };
+
+	// Holds block_mutex and keeps blockVersion odd for as long as it lives
+	class BlockWrite
+	{
+	public:
+		explicit BlockWrite(Chunk& chunk);
+		~BlockWrite();
+		BlockWrite(const BlockWrite&) = delete;
+		BlockWrite& operator=(const BlockWrite&) = delete;
+
+	private:
+		Chunk& chunk;
+		std::lock_guard<std::mutex> lock;
+	};
+
+	// The version to validate against, waits out a write in progress
+	uint32_t BeginBlockRead() const;
+	// True if nothing was written since BeginBlockRead returned version
+	bool EndBlockRead(uint32_t version) const;
+	BlockOccupancy ReadOccupancy() const;
 
 	World* world;
 
-	GLuint VAO, VBO;
+	// Only touched on the render thread
+	VertexArena* meshArena = nullptr;
+	VertexArena::Allocation meshAllocation;
+	uint32_t uploadedVertexCount = 0; // Drawn instead of vertex_count, which can change before the next upload
+	ChunkDrawList::FaceRanges uploadedFaceRanges{};
 	int chunkX, chunkY, chunkZ;
 	std::atomic<bool> isLoaded;
+	std::atomic<bool> hasBlockData{ false }; // Blocks are still valid for the current coordinates
 	std::atomic<bool> isMeshSent;
-	std::atomic<bool> isInitialized;
 	std::atomic<bool> isSetup;
 	std::atomic<bool> needsRebuilding;
+	std::atomic<bool> isUniform{ false };
+	std::atomic<bool> needsSaving{ false };
+	BlockOccupancy occupancy; // Kept up to date by LoadChunk, LoadUniform and SetBlock
 
 	bool isEmpty;
 	bool isFull;
 	bool isSurrounded;
 
-	void InitializeMeshBuffers();
+	const Block* ReadBlocks() const;
+	// The blocks to write to, inside a BlockWrite. If a snapshot holds the current
+	// array the chunk moves to another one first, copying the blocks over if
+	// keepContents is set. Mapped blocks are copied in the same way.
+	Block* WritableBlocks(bool keepContents);
+
+	// Meshes the chunk as cubes of step blocks. A cube is solid if any block in it
+	// is, so a coarse surface never sits below the real one and the faces it shows
+	// towards finer neighbours close any gap between the two.
+	bool AddLodFaces(const Block* source, int step, const LayerCulls* borderCulls, std::vector<uint32_t>* rangeVertices);
+	void SendVertexData(VertexArena& arena);
 	void Clear();
-
-	int Index(int x, int y, int z) const;
 };
 
@@ -0,0 +1,149 @@
+#include "ChunkCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Chunk.h"
+#include "Compression.h"
+
+namespace
+{
+    const size_t HEADER_SIZE = 5; // Version and uncompressed size
+    const size_t PALETTE_ENTRY_SIZE = 5;
+    // Largest possible uncompressed payload: a palette entry and a run for every block
+    const size_t MAX_RAW_SIZE = 2 + Chunk::CHUNK_VOLUME * (PALETTE_ENTRY_SIZE + 3 + 3);
+
+    bool SameBlock(const Block& a, const Block& b) {
+        return a.type == b.type && memcmp(a.edgeData.edges, b.edgeData.edges, sizeof(a.edgeData.edges)) == 0;
+    }
+
+    void WriteVarint(std::vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    bool ReadVarint(const uint8_t* data, size_t size, size_t& position, uint32_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 32; shift += 7) {
+            if (position >= size) return false;
+            uint8_t byte = data[position++];
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+}
+
+void ChunkCodec::Encode(const Block* blocks, std::vector<uint8_t>& out) {
+    std::vector<Block> palette;
+    std::vector<uint8_t> raw;
+    raw.reserve(256);
+    raw.resize(2); // Palette size, filled in below
+
+    std::vector<uint8_t> runs;
+    int index = -1;
+    uint32_t runLength = 0;
+
+    // Runs follow the linear layout whatever the build's block order, so saves
+    // don't depend on it
+    for (int linear = 0; linear < Chunk::CHUNK_VOLUME; linear++) {
+        const Block& block = blocks[ChunkDimensions::FromLinear(linear)];
+        if (index >= 0 && SameBlock(block, palette[index])) {
+            runLength++;
+            continue;
+        }
+
+        if (runLength) {
+            WriteVarint(runs, runLength);
+            WriteVarint(runs, index);
+        }
+
+        index = -1;
+        for (size_t p = 0; p < palette.size(); p++) {
+            if (SameBlock(block, palette[p])) {
+                index = (int)p;
+                break;
+            }
+        }
+        if (index < 0) {
+            index = (int)palette.size();
+            palette.push_back(block);
+        }
+        runLength = 1;
+    }
+    WriteVarint(runs, runLength);
+    WriteVarint(runs, index);
+
+    raw[0] = (uint8_t)(palette.size() & 0xFF);
+    raw[1] = (uint8_t)(palette.size() >> 8);
+    for (const Block& block : palette) {
+        raw.push_back((uint8_t)block.type);
+        raw.insert(raw.end(), block.edgeData.edges, block.edgeData.edges + 4);
+    }
+    raw.insert(raw.end(), runs.begin(), runs.end());
+
+    std::vector<uint8_t> compressed;
+    Compression::Compress(raw.data(), raw.size(), compressed);
+
+    uint32_t rawSize = (uint32_t)raw.size();
+    out.clear();
+    out.reserve(HEADER_SIZE + compressed.size());
+    out.push_back(FORMAT_VERSION);
+    for (int i = 0; i < 4; i++)
+        out.push_back((uint8_t)(rawSize >> (8 * i)));
+    out.insert(out.end(), compressed.begin(), compressed.end());
+}
+
+bool ChunkCodec::Decode(const uint8_t* data, size_t size, Block* blocks, BlockOccupancy& occupancy) {
+    if (size < HEADER_SIZE || data[0] != FORMAT_VERSION)
+        return false;
+
+    uint32_t rawSize = 0;
+    for (int i = 0; i < 4; i++)
+        rawSize |= (uint32_t)data[1 + i] << (8 * i);
+    if (rawSize < 2 || rawSize > MAX_RAW_SIZE)
+        return false;
+
+    std::vector<uint8_t> raw(rawSize);
+    if (!Compression::Decompress(data + HEADER_SIZE, size - HEADER_SIZE, raw.data(), rawSize))
+        return false;
+
+    size_t paletteSize = raw[0] | (raw[1] << 8);
+    size_t position = 2;
+    if (paletteSize == 0 || paletteSize > (rawSize - position) / PALETTE_ENTRY_SIZE)
+        return false;
+
+    std::vector<Block> palette(paletteSize);
+    for (Block& block : palette) {
+        if (raw[position] > (uint8_t)BlockType::STONE)
+            return false;
+        block.type = (BlockType)raw[position];
+        memcpy(block.edgeData.edges, &raw[position + 1], 4);
+        position += PALETTE_ENTRY_SIZE;
+    }
+
+    occupancy = BlockOccupancy();
+    uint32_t written = 0;
+    while (written < (uint32_t)Chunk::CHUNK_VOLUME) {
+        uint32_t runLength, index;
+        if (!ReadVarint(raw.data(), rawSize, position, runLength) || !ReadVarint(raw.data(), rawSize, position, index))
+            return false;
+        if (runLength == 0 || runLength > Chunk::CHUNK_VOLUME - written || index >= paletteSize)
+            return false;
+
+        if constexpr (ChunkDimensions::ORDER == BlockOrder::Linear) {
+            std::fill(blocks + written, blocks + written + runLength, palette[index]);
+        }
+        else {
+            for (uint32_t linear = written; linear < written + runLength; linear++)
+                blocks[ChunkDimensions::FromLinear(linear)] = palette[index];
+        }
+        occupancy.Add(palette[index], runLength);
+        written += runLength;
+    }
+
+    return position == rawSize;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Block.h"
+
+// Serialized form of a chunk's blocks. The blocks are reduced to a palette of the
+// distinct blocks and runs of palette indices in storage order, which is then
+// compressed. Generated terrain is mostly long runs so chunks end up at a few
+// hundred bytes.
+namespace ChunkCodec
+{
+	const uint8_t FORMAT_VERSION = 1;
+
+	void Encode(const Block* blocks, std::vector<uint8_t>& out);
+	// Fails on data that is truncated, corrupt or from an unknown version
+	bool Decode(const uint8_t* data, size_t size, Block* blocks, BlockOccupancy& occupancy);
+};
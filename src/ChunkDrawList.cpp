@@ -0,0 +1,75 @@
+#include "ChunkDrawList.h"
+
+#include <algorithm>
+
+uint32_t ChunkDrawList::VisibleFaceRanges(int32_t minX, int32_t minY, int32_t minZ, int32_t size,
+    float cameraX, float cameraY, float cameraZ) {
+    const int32_t mins[3] = { minX, minY, minZ };
+    const float camera[3] = { cameraX, cameraY, cameraZ };
+
+    uint32_t visible = 1u << SLOPED_FACE_RANGE;
+    for (int axis = 0; axis < 3; axis++) {
+        // Inside the chunk's span on an axis both directions can be seen
+        if (camera[axis] > (float)mins[axis])
+            visible |= 1u << (axis * 2);
+        if (camera[axis] < (float)(mins[axis] + size))
+            visible |= 1u << (axis * 2 + 1);
+    }
+    return visible;
+}
+
+void ChunkDrawList::Clear() {
+    draws.clear();
+    commands.clear();
+    offsets.clear();
+    batches.clear();
+    vertexCount = 0;
+    culledVertexCount = 0;
+}
+
+void ChunkDrawList::Add(int page, uint32_t first, uint32_t count, int32_t offsetX, int32_t offsetY, int32_t offsetZ) {
+    if (count == 0)
+        return;
+
+    draws.push_back(Draw{ page, first, count, Offset{ offsetX, offsetY, offsetZ } });
+    vertexCount += count;
+}
+
+void ChunkDrawList::AddFaceRanges(int page, uint32_t first, const FaceRanges& ranges, uint32_t visibleRanges,
+    int32_t offsetX, int32_t offsetY, int32_t offsetZ) {
+    uint32_t start = first, count = 0;
+    for (int range = 0; range < FACE_RANGE_COUNT; range++) {
+        // An empty range culls nothing, so it doesn't split the draw either
+        if ((visibleRanges & (1u << range)) || ranges[range] == 0) {
+            count += ranges[range];
+            continue;
+        }
+
+        Add(page, start, count, offsetX, offsetY, offsetZ);
+        culledVertexCount += ranges[range];
+        start += count + ranges[range];
+        count = 0;
+    }
+    Add(page, start, count, offsetX, offsetY, offsetZ);
+}
+
+void ChunkDrawList::Build() {
+    commands.clear();
+    offsets.clear();
+    batches.clear();
+
+    // Stable, so draws within a page stay in the order they were added
+    std::stable_sort(draws.begin(), draws.end(), [](const Draw& a, const Draw& b) { return a.page < b.page; });
+
+    commands.reserve(draws.size());
+    offsets.reserve(draws.size());
+    for (const Draw& draw : draws) {
+        if (batches.empty() || batches.back().page != draw.page)
+            batches.push_back(Batch{ draw.page, commands.size(), 0 });
+
+        // Offsets are shared by every page, so base instances count across batches
+        commands.push_back(DrawCommand{ draw.count, 1, draw.first, (uint32_t)offsets.size() });
+        offsets.push_back(draw.offset);
+        batches.back().commandCount++;
+    }
+}
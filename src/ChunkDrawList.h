@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The visible chunks of a frame, grouped into one batch per vertex arena page so
+// each page can be drawn with a single multi-draw call. Nothing here touches GL,
+// the commands match the layout glMultiDrawArraysIndirect reads.
+class ChunkDrawList
+{
+public:
+    // A chunk mesh is split into ranges of faces, back to back in this order. The
+    // first six follow Block's faces: +X, -X, +Y, -Y, +Z, -Z.
+    static const int FACE_RANGE_COUNT = 7;
+    // Sloped tops and bottoms don't face a single direction, so they're always drawn
+    static const int SLOPED_FACE_RANGE = 6;
+    // Vertex count of each range
+    using FaceRanges = std::array<uint32_t, FACE_RANGE_COUNT>;
+
+    struct DrawCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t first;
+        uint32_t baseInstance; // Index of the draw's offset in GetOffsets
+    };
+
+    struct Batch {
+        int page;
+        size_t firstCommand;
+        size_t commandCount;
+    };
+
+    // Block position of a chunk's origin, read as a per-instance attribute
+    struct Offset {
+        int32_t x, y, z;
+    };
+
+    // Bit per face range that can have faces turned towards a camera at the given
+    // position. Faces of one direction lie on planes within the chunk's bounds, so
+    // for example no +X face can be seen from at or below the chunk's lowest x.
+    static uint32_t VisibleFaceRanges(int32_t minX, int32_t minY, int32_t minZ, int32_t size,
+        float cameraX, float cameraY, float cameraZ);
+
+    void Clear();
+    // first and count are in vertices within the page
+    void Add(int page, uint32_t first, uint32_t count, int32_t offsetX, int32_t offsetY, int32_t offsetZ);
+    // Adds the ranges of a mesh starting at first that are set in visibleRanges,
+    // ranges that end up next to each other are drawn together
+    void AddFaceRanges(int page, uint32_t first, const FaceRanges& ranges, uint32_t visibleRanges,
+        int32_t offsetX, int32_t offsetY, int32_t offsetZ);
+    // Orders the draws by page and builds the batches, call once after the last Add
+    void Build();
+
+    const std::vector<DrawCommand>& GetCommands() const { return commands; }
+    const std::vector<Offset>& GetOffsets() const { return offsets; }
+    const std::vector<Batch>& GetBatches() const { return batches; }
+    size_t Size() const { return commands.size(); }
+    uint32_t GetVertexCount() const { return vertexCount; }
+    // Vertices left out by AddFaceRanges since the last Clear
+    uint32_t GetCulledVertexCount() const { return culledVertexCount; }
+
+private:
+    struct Draw {
+        int page;
+        uint32_t first, count;
+        Offset offset;
+    };
+
+    std::vector<Draw> draws;
+    std::vector<DrawCommand> commands;
+    std::vector<Offset> offsets;
+    std::vector<Batch> batches;
+    uint32_t vertexCount = 0;
+    uint32_t culledVertexCount = 0;
+};
@@ -0,0 +1,258 @@
+#include "ChunkIO.h"
+
+#include <iostream>
+
+ChunkIO::ChunkIO(WorldStorage* storage, size_t queueCapacity)
+    : storage(storage), queueCapacity(queueCapacity), rateTime(std::chrono::steady_clock::now()) {
+    thread = std::thread(&ChunkIO::ThreadLoop, this);
+}
+
+ChunkIO::~ChunkIO() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+ChunkIO::LoadStatus ChunkIO::Load(int chunkX, int chunkY, int chunkZ, std::shared_ptr<const ChunkData>& data) {
+    auto key = std::make_tuple(chunkX, chunkY, chunkZ);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Newer than anything on disk
+    auto write = pendingWrites.find(key);
+    if (write != pendingWrites.end()) {
+        data = write->second;
+        loads++;
+        return LoadStatus::Found;
+    }
+
+    auto result = readResults.find(key);
+    if (result != readResults.end()) {
+        data = result->second.data;
+        loads++;
+        if (result->second.prefetched)
+            prefetchHits++;
+        readResults.erase(result);
+        return data ? LoadStatus::Found : LoadStatus::Missing;
+    }
+
+    if (queuedReads.count(key)) {
+        // Already on its way as a prefetch, move it to the front
+        for (auto iterator = prefetchQueue.begin(); iterator != prefetchQueue.end(); ++iterator) {
+            if (*iterator == key) {
+                prefetchQueue.erase(iterator);
+                loadQueue.push_back(key);
+                break;
+            }
+        }
+        return LoadStatus::Pending;
+    }
+
+    // Chunks in regions that are already open can be answered without touching the disk
+    if (storage->IsKnownMissing(chunkX, chunkY, chunkZ)) {
+        loads++;
+        return LoadStatus::Missing;
+    }
+
+    if (loadQueue.size() + prefetchQueue.size() >= queueCapacity) {
+        if (prefetchQueue.empty())
+            return LoadStatus::Pending;
+        queuedReads.erase(prefetchQueue.back());
+        prefetchQueue.pop_back();
+    }
+
+    loadQueue.push_back(key);
+    queuedReads.insert(key);
+    wake.notify_one();
+    return LoadStatus::Pending;
+}
+
+void ChunkIO::Prefetch(int chunkX, int chunkY, int chunkZ) {
+    auto key = std::make_tuple(chunkX, chunkY, chunkZ);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (loadQueue.size() + prefetchQueue.size() >= queueCapacity || queuedReads.count(key) ||
+        readResults.count(key) || pendingWrites.count(key))
+        return;
+
+    prefetchQueue.push_back(key);
+    queuedReads.insert(key);
+    wake.notify_one();
+}
+
+void ChunkIO::Save(int chunkX, int chunkY, int chunkZ, std::shared_ptr<const ChunkData> data) {
+    auto key = std::make_tuple(chunkX, chunkY, chunkZ);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingWrites[key] = std::move(data);
+        if (queuedWrites.insert(key).second)
+            writeQueue.push_back(key);
+
+        // Anything read before this is out of date
+        readResults.erase(key);
+        if (isReading && readInFlight == key)
+            readInFlightStale = true;
+    }
+    wake.notify_one();
+}
+
+bool ChunkIO::HasWriteRoom(int chunkX, int chunkY, int chunkZ) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeQueue.size() < queueCapacity || queuedWrites.count(std::make_tuple(chunkX, chunkY, chunkZ));
+}
+
+void ChunkIO::WaitForWriteRoom() {
+    std::unique_lock<std::mutex> lock(mutex);
+    writesDone.wait(lock, [this] { return writeQueue.size() < queueCapacity; });
+}
+
+void ChunkIO::AppendJournal(std::vector<BlockEdit> edits) {
+    if (edits.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        journalQueue.push_back(std::move(edits));
+    }
+    wake.notify_one();
+}
+
+bool ChunkIO::Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (const Key& key : failedWrites) {
+        if (queuedWrites.insert(key).second)
+            writeQueue.push_back(key);
+    }
+    failedWrites.clear();
+    wake.notify_one();
+
+    writesDone.wait(lock, [this] { return journalQueue.empty() && writeQueue.empty() && writesInFlight == 0; });
+    return failedWrites.empty();
+}
+
+ChunkIO::Stats ChunkIO::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - rateTime).count();
+    if (elapsed >= 1.0) {
+        uint64_t bytesRead = storage->GetBytesRead();
+        uint64_t bytesWritten = storage->GetBytesWritten();
+        readBytesPerSecond = (bytesRead - rateBytesRead) / elapsed;
+        writeBytesPerSecond = (bytesWritten - rateBytesWritten) / elapsed;
+        rateBytesRead = bytesRead;
+        rateBytesWritten = bytesWritten;
+        rateTime = now;
+    }
+
+    return Stats{ loadQueue.size() + prefetchQueue.size(), writeQueue.size(), readBytesPerSecond, writeBytesPerSecond, loads, prefetchHits };
+}
+
+void ChunkIO::ThreadLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] {
+            return stopping || !journalQueue.empty() || !loadQueue.empty() || !writeQueue.empty() || !prefetchQueue.empty();
+        });
+
+        // Journal batches come first so no region write overtakes them, then loads
+        // the world is waiting on, then writes, then reads ahead. Queued batches and
+        // writes are still finished when stopping.
+        if (!journalQueue.empty()) {
+            std::vector<BlockEdit> edits = std::move(journalQueue.front());
+            journalQueue.pop_front();
+            writesInFlight++;
+            lock.unlock();
+            storage->GetJournal().Append(edits);
+            lock.lock();
+            writesInFlight--;
+            writesDone.notify_all();
+        }
+        else if (!stopping && !loadQueue.empty()) {
+            Key key = loadQueue.front();
+            loadQueue.pop_front();
+            lock.unlock();
+            Read(key, false);
+            lock.lock();
+        }
+        else if (!writeQueue.empty()) {
+            Key key = writeQueue.front();
+            writeQueue.pop_front();
+            queuedWrites.erase(key);
+            // Counted before the lock is let go, or Flush could see no writes left
+            writesInFlight++;
+            lock.unlock();
+            Write(key);
+            lock.lock();
+        }
+        else if (!stopping && !prefetchQueue.empty()) {
+            Key key = prefetchQueue.front();
+            prefetchQueue.pop_front();
+            lock.unlock();
+            Read(key, true);
+            lock.lock();
+        }
+        else if (stopping) {
+            break;
+        }
+    }
+}
+
+void ChunkIO::Read(const Key& key, bool prefetched) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        readInFlight = key;
+        isReading = true;
+        readInFlightStale = false;
+    }
+
+    auto data = std::make_shared<ChunkData>();
+    auto blocks = std::make_shared<Chunk::BlockArray>();
+    bool found = storage->LoadChunk(std::get<0>(key), std::get<1>(key), std::get<2>(key), blocks->data(), data->occupancy);
+    data->blocks = std::move(blocks);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    isReading = false;
+    queuedReads.erase(key);
+    if (readInFlightStale)
+        return;
+
+    readResults[key] = ReadResult{ found ? std::move(data) : nullptr, prefetched };
+    readResultOrder.push_back(key);
+    DropOldReadResults();
+}
+
+void ChunkIO::Write(const Key& key) {
+    std::shared_ptr<const ChunkData> data;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        data = pendingWrites[key];
+    }
+
+    bool saved = storage->SaveChunk(std::get<0>(key), std::get<1>(key), std::get<2>(key), data->blocks->data());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // A newer copy may have been queued while writing, it stays pending. So does
+        // a copy that failed to write, until the next flush tries again.
+        auto search = pendingWrites.find(key);
+        if (saved && search != pendingWrites.end() && search->second == data)
+            pendingWrites.erase(search);
+        if (!saved) {
+            failedWrites.insert(key);
+            std::cerr << "Failed to save chunk (" << std::get<0>(key) << "," << std::get<1>(key) << "," << std::get<2>(key) << ")" << std::endl;
+        }
+        writesInFlight--;
+    }
+    writesDone.notify_all();
+}
+
+void ChunkIO::DropOldReadResults() {
+    // Keys of results Load already took are simply skipped over
+    while (readResultOrder.size() > MAX_READ_RESULTS) {
+        readResults.erase(readResultOrder.front());
+        readResultOrder.pop_front();
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Chunk.h"
+#include "WorldStorage.h"
+
+struct ChunkData {
+    // Saved chunks share this with the chunk until its next edit, see Chunk::BlockSnapshot
+    std::shared_ptr<const Chunk::BlockArray> blocks;
+    BlockOccupancy occupancy;
+};
+
+// Runs all chunk reads and writes on its own thread so neither the world thread
+// nor the render thread ever waits on the disk. Reads are queued in a bounded
+// queue, with loads the world needs now ahead of prefetches. Writes take a
+// snapshot of the blocks and are coalesced per chunk; a chunk read while its write
+// is still queued is served from the snapshot. Edit journal batches are appended
+// here too, ahead of everything else.
+class ChunkIO
+{
+public:
+    enum class LoadStatus { Pending, Found, Missing };
+
+    struct Stats {
+        size_t queuedReads;
+        size_t queuedWrites;
+        double readBytesPerSecond;
+        double writeBytesPerSecond;
+        uint64_t loads;         // Chunks handed to the world that were found on disk or known missing
+        uint64_t prefetchHits;  // Of those, how many were read ahead of time
+    };
+
+    static const size_t DEFAULT_QUEUE_CAPACITY = 256;
+
+    ChunkIO(WorldStorage* storage, size_t queueCapacity = DEFAULT_QUEUE_CAPACITY);
+    ~ChunkIO();
+
+    // Pending until the chunk has been read, call again on a later frame
+    LoadStatus Load(int chunkX, int chunkY, int chunkZ, std::shared_ptr<const ChunkData>& data);
+    // Dropped if the queue is full, the world asks again for anything it still needs
+    void Prefetch(int chunkX, int chunkY, int chunkZ);
+    // Writes share the queue capacity. Check HasWriteRoom first and keep the chunk
+    // dirty if there's none, two threads saving at once can go a little past it.
+    void Save(int chunkX, int chunkY, int chunkZ, std::shared_ptr<const ChunkData> data);
+    // True if the write queue has room, or a write of the chunk is queued to coalesce with
+    bool HasWriteRoom(int chunkX, int chunkY, int chunkZ);
+    void WaitForWriteRoom();
+    // Batches reach the journal in the order they're queued and before any region
+    // write queued after them, so a region never gets ahead of the journal. A crash
+    // loses the batches still queued.
+    void AppendJournal(std::vector<BlockEdit> edits);
+    // Waits for every queued write and journal batch. Failed writes keep their copy
+    // and are retried here, false if any of them still fails.
+    bool Flush();
+
+    Stats GetStats();
+
+private:
+    typedef std::tuple<int, int, int> Key;
+
+    // Finished reads nobody has claimed are dropped past this many
+    static const size_t MAX_READ_RESULTS = 512;
+
+    struct ReadResult {
+        std::shared_ptr<const ChunkData> data; // Null if the chunk was never saved
+        bool prefetched;
+    };
+
+    WorldStorage* storage;
+    size_t queueCapacity;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable writesDone;
+    bool stopping = false;
+
+    std::deque<Key> loadQueue, prefetchQueue;
+    std::unordered_set<Key, hash_tuple> queuedReads;
+    std::unordered_map<Key, ReadResult, hash_tuple> readResults;
+    std::deque<Key> readResultOrder;
+
+    Key readInFlight;
+    bool isReading = false;
+    bool readInFlightStale = false; // A write was queued for the chunk while it was being read
+
+    std::unordered_map<Key, std::shared_ptr<const ChunkData>, hash_tuple> pendingWrites;
+    std::deque<Key> writeQueue;
+    std::unordered_set<Key, hash_tuple> queuedWrites;
+    std::unordered_set<Key, hash_tuple> failedWrites;
+    std::deque<std::vector<BlockEdit>> journalQueue;
+    size_t writesInFlight = 0; // Journal batches included
+
+    uint64_t loads = 0, prefetchHits = 0;
+    std::chrono::steady_clock::time_point rateTime;
+    uint64_t rateBytesRead = 0, rateBytesWritten = 0;
+    double readBytesPerSecond = 0, writeBytesPerSecond = 0;
+
+    std::thread thread;
+
+    void ThreadLoop();
+    void Read(const Key& key, bool prefetched);
+    void Write(const Key& key);
+    void DropOldReadResults();
+};
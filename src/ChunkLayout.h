@@ -0,0 +1,125 @@
+#pragma once
+
+// Edge length of a chunk in blocks, set at configure time with -DVOXEL_CHUNK_SIZE
+#ifndef VOXEL_CHUNK_SIZE
+#define VOXEL_CHUNK_SIZE 16
+#endif
+
+// How a chunk's blocks are ordered in memory
+enum class BlockOrder {
+    // x fastest, then y, then z. Neighbours along z are Size^2 blocks apart.
+    Linear,
+    // 4x4x4 bricks in linear order, each brick linear inside. All six neighbours
+    // of most blocks are within the same 64 blocks.
+    Brick,
+    // Z-curve, x, y and z bits interleaved, so blocks close in space are close in
+    // memory at every scale
+    Morton,
+};
+
+// Set at configure time with -DVOXEL_BLOCK_ORDER
+#ifndef VOXEL_BLOCK_ORDER
+#define VOXEL_BLOCK_ORDER Linear
+#endif
+
+// Sizes and coordinate conversions for chunks of Size^3 blocks. Larger chunks mean
+// fewer draws and chunk map entries, smaller ones cheaper remeshing after an edit.
+template <int Size, BlockOrder Order = BlockOrder::Linear>
+struct ChunkLayout
+{
+    static_assert(Size == 16 || Size == 32, "Chunks are 16 or 32 blocks, the vertex packing and LOD levels assume one of those");
+
+    static constexpr int SIZE = Size;
+    static constexpr int AREA = Size * Size;
+    static constexpr int VOLUME = Size * Size * Size;
+    static constexpr int SHIFT = Size == 16 ? 4 : 5;
+    static constexpr int MASK = Size - 1;
+    static constexpr BlockOrder ORDER = Order;
+
+    static constexpr int BRICK_SIZE = 4;
+    static constexpr int BRICKS = Size / BRICK_SIZE;
+
+    // Position of block x, y, z in the chunk's block array
+    static constexpr int Index(int x, int y, int z) {
+        if constexpr (Order == BlockOrder::Brick) {
+            int brick = (x >> 2) + BRICKS * ((y >> 2) + BRICKS * (z >> 2));
+            return brick * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE + (x & 3) + BRICK_SIZE * ((y & 3) + BRICK_SIZE * (z & 3));
+        }
+        else if constexpr (Order == BlockOrder::Morton) {
+            return SPREAD[x] | SPREAD[y] << 1 | SPREAD[z] << 2;
+        }
+        else {
+            return x + Size * (y + Size * z);
+        }
+    }
+
+    // Index of the block at a position counted in linear order, for formats that
+    // have to be the same whatever the layout
+    static constexpr int FromLinear(int linear) {
+        return Index(linear & MASK, (linear >> SHIFT) & MASK, linear >> (2 * SHIFT));
+    }
+
+    // Calls f(x, y, z, index) for every block in memory order, for passes over a
+    // whole chunk that don't care which order they see blocks in
+    template <typename F>
+    static void ForEachVoxel(F&& f) {
+        if constexpr (Order == BlockOrder::Brick) {
+            int index = 0;
+            for (int bz = 0; bz < Size; bz += BRICK_SIZE)
+                for (int by = 0; by < Size; by += BRICK_SIZE)
+                    for (int bx = 0; bx < Size; bx += BRICK_SIZE)
+                        for (int z = bz; z < bz + BRICK_SIZE; z++)
+                            for (int y = by; y < by + BRICK_SIZE; y++)
+                                for (int x = bx; x < bx + BRICK_SIZE; x++)
+                                    f(x, y, z, index++);
+        }
+        else if constexpr (Order == BlockOrder::Morton) {
+            // The low six bits of an index are a 4x4x4 brick, the bits above it
+            // the brick's own position on the curve
+            int index = 0;
+            for (int brick = 0; brick < VOLUME / 64; brick++) {
+                int bx = Compact(brick) * BRICK_SIZE, by = Compact(brick >> 1) * BRICK_SIZE, bz = Compact(brick >> 2) * BRICK_SIZE;
+                for (int local = 0; local < 64; local++)
+                    f(bx + Compact(local), by + Compact(local >> 1), bz + Compact(local >> 2), index++);
+            }
+        }
+        else {
+            int index = 0;
+            for (int z = 0; z < Size; z++)
+                for (int y = 0; y < Size; y++)
+                    for (int x = 0; x < Size; x++)
+                        f(x, y, z, index++);
+        }
+    }
+
+    // Chunk holding a world block coordinate, rounding towards negative infinity
+    static constexpr int ToChunk(int block) { return block >> SHIFT; }
+    // Position of a world block coordinate within its chunk
+    static constexpr int ToLocal(int block) { return block & MASK; }
+
+private:
+    // Moves bit i of a coordinate to bit 3i, looked up since Index is in every hot loop
+    struct SpreadTable {
+        int values[Size];
+
+        constexpr SpreadTable() : values() {
+            for (int value = 0; value < Size; value++) {
+                for (int bit = 0; bit < SHIFT; bit++)
+                    values[value] |= ((value >> bit) & 1) << (3 * bit);
+            }
+        }
+
+        constexpr int operator[](int value) const { return values[value]; }
+    };
+    static constexpr SpreadTable SPREAD{};
+
+    // Inverse of SPREAD, reads every third bit
+    static constexpr int Compact(int value) {
+        int result = 0;
+        for (int bit = 0; bit < SHIFT; bit++)
+            result |= ((value >> (3 * bit)) & 1) << bit;
+        return result;
+    }
+};
+
+using ChunkDimensions = ChunkLayout<VOXEL_CHUNK_SIZE, BlockOrder::VOXEL_BLOCK_ORDER>;
@@ -0,0 +1,109 @@
+#include "ChunkPool.h"
+
+ChunkPool::ChunkPool(const EpochReclaimer& reclaimer, size_t capacity, size_t warmCount)
+    : reclaimer(reclaimer), capacity(capacity), warmCount(warmCount) {
+    trimBoundary = chunks.end();
+}
+
+void ChunkPool::Release(std::unique_ptr<Chunk> chunk, uint64_t retireEpoch) {
+    auto coords = chunk->GetCoords();
+    auto key = std::make_tuple(coords.x, coords.y, coords.z);
+
+    // A stale entry for the same coordinates can't be restored anymore
+    auto search = index.find(key);
+    if (search != index.end()) {
+        Remove(search->second);
+    }
+
+    chunks.push_front(Entry{ std::move(chunk), false, retireEpoch });
+    index[key] = chunks.begin();
+    untrimmedCount++;
+
+    EvictOverCapacity();
+    TrimIdle();
+}
+
+std::unique_ptr<Chunk> ChunkPool::Restore(int chunkX, int chunkY, int chunkZ) {
+    auto search = index.find(std::make_tuple(chunkX, chunkY, chunkZ));
+    if (search == index.end())
+        return nullptr;
+
+    return Remove(search->second);
+}
+
+std::unique_ptr<Chunk> ChunkPool::Recycle() {
+    if (!CanReclaimOldest())
+        return nullptr;
+
+    // Nothing can be reading it anymore, so arrays left by snapshots can go
+    auto chunk = Remove(std::prev(chunks.end()));
+    chunk->ReleaseSpareBlocks();
+    return chunk;
+}
+
+size_t ChunkPool::Shrink(size_t bytes) {
+    size_t freed = 0;
+    while (freed < bytes && CanReclaimOldest()) {
+        auto chunk = Remove(std::prev(chunks.end()));
+        freed += chunk->GetMemoryUsage();
+    }
+    return freed;
+}
+
+void ChunkPool::SetCapacity(size_t capacity) {
+    ChunkPool::capacity = capacity;
+    EvictOverCapacity();
+}
+
+size_t ChunkPool::GetMemoryUsage() const {
+    size_t bytes = 0;
+    for (auto& entry : chunks) {
+        bytes += entry.chunk->GetMemoryUsage();
+    }
+    return bytes;
+}
+
+std::unique_ptr<Chunk> ChunkPool::Remove(EntryIterator iterator) {
+    auto coords = iterator->chunk->GetCoords();
+    index.erase(std::make_tuple(coords.x, coords.y, coords.z));
+
+    if (iterator == trimBoundary) {
+        trimBoundary = std::next(iterator);
+    }
+    if (!iterator->trimmed) {
+        untrimmedCount--;
+    }
+
+    std::unique_ptr<Chunk> chunk = std::move(iterator->chunk);
+    chunks.erase(iterator);
+    return chunk;
+}
+
+bool ChunkPool::CanReclaimOldest() const {
+    // A mesh still being written keeps the chunk, whatever the epoch says
+    return !chunks.empty() && reclaimer.IsReclaimable(chunks.back().retireEpoch) && !chunks.back().chunk->IsGeneratingMesh();
+}
+
+void ChunkPool::EvictOverCapacity() {
+    while (chunks.size() > capacity && CanReclaimOldest()) {
+        Remove(std::prev(chunks.end()));
+    }
+}
+
+void ChunkPool::TrimIdle() {
+    while (untrimmedCount > warmCount && trimBoundary != chunks.begin()) {
+        auto candidate = std::prev(trimBoundary);
+
+        // The world thread may still be meshing a chunk retired since its last pass,
+        // and newer entries were retired later still, so try again on the next release
+        if (!reclaimer.IsReclaimable(candidate->retireEpoch))
+            break;
+        // Can't free the mesh while a thread is still writing it
+        if (!candidate->chunk->ReleaseMesh())
+            break;
+
+        candidate->trimmed = true;
+        trimBoundary = candidate;
+        untrimmedCount--;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <tuple>
+
+#include "Chunk.h"
+#include "EpochReclaimer.h"
+
+// Holds chunks that dropped out of the render distance. A chunk released here
+// keeps its blocks so it can be restored without regenerating terrain if the
+// player turns back. Only the most recently released chunks keep their meshes,
+// older ones are trimmed down to block data and the oldest are recycled for new
+// coordinates or destroyed once the pool is over capacity.
+//
+// Other threads can still hold a released chunk, so it's only recycled or destroyed
+// once the reclaimer has seen every reader go quiescent since it was retired. Until
+// then the pool can go over capacity. Restoring it for the same coordinates is
+// always fine, whoever holds it still sees the same chunk.
+class ChunkPool
+{
+public:
+    static const size_t DEFAULT_CAPACITY = 1024;
+    static const size_t DEFAULT_WARM_COUNT = 128;
+
+    ChunkPool(const EpochReclaimer& reclaimer, size_t capacity = DEFAULT_CAPACITY, size_t warmCount = DEFAULT_WARM_COUNT);
+
+    // Must be called on the render thread since trimming frees GL buffers. The
+    // chunk has to be unreachable already, retireEpoch is what retiring it returned.
+    void Release(std::unique_ptr<Chunk> chunk, uint64_t retireEpoch);
+    std::unique_ptr<Chunk> Restore(int chunkX, int chunkY, int chunkZ);
+    // Null if the pool is empty or every chunk in it may still be in use
+    std::unique_ptr<Chunk> Recycle();
+
+    // Destroys least recently used chunks until at least the given amount is freed,
+    // or none are left that can be
+    size_t Shrink(size_t bytes);
+
+    void SetCapacity(size_t capacity);
+    size_t GetCapacity() const { return capacity; }
+    size_t Size() const { return chunks.size(); }
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Entry {
+        std::unique_ptr<Chunk> chunk;
+        bool trimmed;
+        uint64_t retireEpoch;
+    };
+
+    typedef std::list<Entry>::iterator EntryIterator;
+
+    std::list<Entry> chunks; // Most recently released at the front
+    std::unordered_map<std::tuple<int, int, int>, EntryIterator, hash_tuple> index;
+
+    // Trimmed entries always form the tail of the list, this points at the first one
+    EntryIterator trimBoundary;
+    size_t untrimmedCount = 0;
+
+    const EpochReclaimer& reclaimer;
+    size_t capacity;
+    size_t warmCount;
+
+    std::unique_ptr<Chunk> Remove(EntryIterator iterator);
+    // Entries are retired in list order, so if the oldest can't be reclaimed none can.
+    // Recycling, capacity eviction and Shrink all stop there.
+    bool CanReclaimOldest() const;
+    void EvictOverCapacity();
+    void TrimIdle();
+};
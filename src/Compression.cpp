@@ -0,0 +1,161 @@
+#include "Compression.h"
+
+#include <array>
+#include <cstring>
+
+namespace
+{
+    const int MIN_MATCH = 4;
+    // The format requires the last match to start at least 12 bytes before the end
+    // and the last 5 bytes to be literals
+    const size_t MATCH_FIND_LIMIT = 12;
+    const size_t LAST_LITERALS = 5;
+    const size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 12;
+
+    uint32_t Read32(const uint8_t* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t Hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void WriteLength(std::vector<uint8_t>& out, size_t length) {
+        while (length >= 255) {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back((uint8_t)length);
+    }
+
+    void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength) {
+        size_t matchCode = matchLength - MIN_MATCH;
+        uint8_t token = (uint8_t)((literalLength < 15 ? literalLength : 15) << 4);
+        if (offset)
+            token |= matchCode < 15 ? matchCode : 15;
+        out.push_back(token);
+
+        if (literalLength >= 15)
+            WriteLength(out, literalLength - 15);
+        out.insert(out.end(), literals, literals + literalLength);
+
+        if (!offset)
+            return;
+
+        out.push_back((uint8_t)(offset & 0xFF));
+        out.push_back((uint8_t)(offset >> 8));
+        if (matchCode >= 15)
+            WriteLength(out, matchCode - 15);
+    }
+
+    std::array<uint32_t, 256> MakeCrcTable() {
+        std::array<uint32_t, 256> table;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }
+
+    bool ReadLength(const uint8_t* src, size_t size, size_t& ip, size_t& length) {
+        uint8_t byte;
+        do {
+            if (ip >= size) return false;
+            byte = src[ip++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+void Compression::Compress(const uint8_t* src, size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(size / 2 + 16);
+
+    size_t anchor = 0;
+    if (size > MATCH_FIND_LIMIT) {
+        int32_t table[1 << HASH_BITS];
+        memset(table, -1, sizeof(table));
+
+        size_t matchLimit = size - LAST_LITERALS;
+        size_t ip = 0;
+        while (ip < size - MATCH_FIND_LIMIT) {
+            uint32_t sequence = Read32(src + ip);
+            uint32_t hash = Hash(sequence);
+            int32_t candidate = table[hash];
+            table[hash] = (int32_t)ip;
+
+            if (candidate < 0 || ip - candidate > MAX_OFFSET || Read32(src + candidate) != sequence) {
+                ip++;
+                continue;
+            }
+
+            size_t length = MIN_MATCH;
+            while (ip + length < matchLimit && src[candidate + length] == src[ip + length])
+                length++;
+
+            WriteSequence(out, src + anchor, ip - anchor, ip - candidate, length);
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    WriteSequence(out, src + anchor, size - anchor, 0, MIN_MATCH);
+}
+
+bool Compression::Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize) {
+    size_t ip = 0, op = 0;
+
+    while (ip < size) {
+        uint8_t token = src[ip++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLength(src, size, ip, literalLength))
+            return false;
+        if (literalLength > size - ip || literalLength > dstSize - op)
+            return false;
+        memcpy(dst + op, src + ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // The last sequence has no match
+        if (ip == size)
+            break;
+
+        if (size - ip < 2)
+            return false;
+        size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op)
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !ReadLength(src, size, ip, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+        if (matchLength > dstSize - op)
+            return false;
+
+        // Matches may overlap the bytes they produce, so copy forwards one at a time
+        const uint8_t* match = dst + op - offset;
+        for (size_t i = 0; i < matchLength; i++)
+            dst[op + i] = match[i];
+        op += matchLength;
+    }
+
+    return op == dstSize;
+}
+
+uint32_t Compression::Crc32(const uint8_t* data, size_t size) {
+    static const std::array<uint32_t, 256> table = MakeCrcTable();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
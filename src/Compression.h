@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte level helpers for saved data. Compressed data uses the LZ4 block format:
+// fast enough to decompress chunks while streaming, at the cost of ratio.
+namespace Compression
+{
+	// Replaces out with the compressed form of size bytes at src
+	void Compress(const uint8_t* src, size_t size, std::vector<uint8_t>& out);
+	// Fails unless the data decompresses to exactly dstSize bytes
+	bool Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize);
+
+	uint32_t Crc32(const uint8_t* data, size_t size);
+};
@@ -106,16 +106,12 @@ Debugging::~Debugging() {
     glDeleteBuffers(1, &VBO);
 }
 
-void Debugging::DrawCube(Shader& shader, glm::mat4 view, glm::mat4 projection, glm::vec3 pos)
+void Debugging::DrawCube(Shader& shader, glm::vec3 pos)
 {
     shader.Use();
 
-    glm::mat4 model = glm::mat4(1.0f);
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
     shader.SetUniform("model", model);
-    shader.SetUniform("projection", projection);
-
-    glm::mat4 newViewMatrix = glm::translate(view, pos);
-    shader.SetUniform("view", newViewMatrix);
 
     glDisable(GL_DEPTH_TEST);
 
@@ -11,7 +11,7 @@ class Debugging
 public:
     Debugging();
     ~Debugging();
-    void DrawCube(Shader& shader, glm::mat4 view, glm::mat4 projection, glm::vec3 pos);
+    void DrawCube(Shader& shader, glm::vec3 pos);
 
 private:
     GLuint VAO, VBO;
@@ -0,0 +1,158 @@
+#include "DensityGenerator.h"
+
+#include <math.h>
+
+static unsigned int HashLattice(int ix, int iy, int iz, unsigned int seed) {
+    unsigned int h = seed;
+    h ^= (unsigned int)ix * 3284157443u;
+    h = (h << 13) | (h >> 19);
+    h ^= (unsigned int)iy * 1911520717u;
+    h = (h << 13) | (h >> 19);
+    h ^= (unsigned int)iz * 2048419325u;
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    return h;
+}
+
+// Gradient noise with the twelve cube edge directions as gradients
+static float DotLatticeGradient(int ix, int iy, int iz, float x, float y, float z, unsigned int seed) {
+    static const float gradients[12][3] = {
+        { 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+        { 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+        { 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 }
+    };
+    const float* g = gradients[HashLattice(ix, iy, iz, seed) % 12];
+    return (x - ix) * g[0] + (y - iy) * g[1] + (z - iz) * g[2];
+}
+
+static float Fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static float Lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+DensityGenerator::DensityGenerator(TerrainGenerator* terrainGenerator, unsigned int seed)
+    : seed(seed), heightmapCache(terrainGenerator) {}
+
+float DensityGenerator::Noise(float x, float y, float z) const {
+    int x0 = (int)floor(x), y0 = (int)floor(y), z0 = (int)floor(z);
+    float sx = Fade(x - x0), sy = Fade(y - y0), sz = Fade(z - z0);
+
+    float n000 = DotLatticeGradient(x0, y0, z0, x, y, z, seed);
+    float n100 = DotLatticeGradient(x0 + 1, y0, z0, x, y, z, seed);
+    float n010 = DotLatticeGradient(x0, y0 + 1, z0, x, y, z, seed);
+    float n110 = DotLatticeGradient(x0 + 1, y0 + 1, z0, x, y, z, seed);
+    float n001 = DotLatticeGradient(x0, y0, z0 + 1, x, y, z, seed);
+    float n101 = DotLatticeGradient(x0 + 1, y0, z0 + 1, x, y, z, seed);
+    float n011 = DotLatticeGradient(x0, y0 + 1, z0 + 1, x, y, z, seed);
+    float n111 = DotLatticeGradient(x0 + 1, y0 + 1, z0 + 1, x, y, z, seed);
+
+    return Lerp(Lerp(Lerp(n000, n100, sx), Lerp(n010, n110, sx), sy),
+                Lerp(Lerp(n001, n101, sx), Lerp(n011, n111, sx), sy), sz);
+}
+
+float DensityGenerator::GetDensity(int x, int y, int z, float surfaceHeight) const {
+    float noise = Noise(x / NOISE_SIZE, y / NOISE_SIZE, z / NOISE_SIZE)
+        + 0.5f * Noise(x * 2 / NOISE_SIZE, y * 2 / NOISE_SIZE, z * 2 / NOISE_SIZE);
+    return surfaceHeight - y + noise * NOISE_AMPLITUDE;
+}
+
+BlockOccupancy DensityGenerator::FillChunk(int chunkX, int chunkY, int chunkZ, Block* blocks) {
+    const int CHUNK_SIZE = Chunk::CHUNK_SIZE;
+    auto heightmap = heightmapCache.Get(chunkX, chunkZ);
+
+    int worldX = chunkX * CHUNK_SIZE;
+    int worldY = chunkY * CHUNK_SIZE;
+    int worldZ = chunkZ * CHUNK_SIZE;
+
+    // The lattice lines up with world coordinates so neighbouring chunks agree on their shared faces
+    float lattice[LATTICE_X][LATTICE_Y][LATTICE_X];
+    for (int lx = 0; lx < LATTICE_X; lx++) {
+        for (int lz = 0; lz < LATTICE_X; lz++) {
+            float surfaceHeight = heightmap->Get(lx * LATTICE_SPACING, lz * LATTICE_SPACING);
+            for (int ly = 0; ly < LATTICE_Y; ly++) {
+                lattice[lx][ly][lz] = GetDensity(worldX + lx * LATTICE_SPACING, worldY + ly * LATTICE_SPACING,
+                    worldZ + lz * LATTICE_SPACING, surfaceHeight);
+            }
+        }
+    }
+
+    const float step = 1.0f / LATTICE_SPACING;
+    const int columnHeight = CHUNK_SIZE + SURFACE_DEPTH;
+    BlockOccupancy occupancy;
+
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+        int lz = z / LATTICE_SPACING;
+        float tz = (z % LATTICE_SPACING) * step;
+
+        // Walk down each column so every solid block knows how many solid blocks are above it
+        BlockType slice[CHUNK_SIZE][CHUNK_SIZE]; // [y][x]
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            int lx = x / LATTICE_SPACING;
+            float tx = (x % LATTICE_SPACING) * step;
+
+            int depth = 0;
+            for (int y = columnHeight - 1; y >= 0; y--) {
+                int ly = y / LATTICE_SPACING;
+                float ty = (y % LATTICE_SPACING) * step;
+
+                float density = Lerp(
+                    Lerp(Lerp(lattice[lx][ly][lz], lattice[lx + 1][ly][lz], tx),
+                         Lerp(lattice[lx][ly + 1][lz], lattice[lx + 1][ly + 1][lz], tx), ty),
+                    Lerp(Lerp(lattice[lx][ly][lz + 1], lattice[lx + 1][ly][lz + 1], tx),
+                         Lerp(lattice[lx][ly + 1][lz + 1], lattice[lx + 1][ly + 1][lz + 1], tx), ty), tz);
+
+                depth = density > 0.0f ? depth + 1 : 0;
+                if (y >= CHUNK_SIZE)
+                    continue;
+
+                if (depth == 0)
+                    slice[y][x] = BlockType::AIR;
+                else if (depth == 1)
+                    slice[y][x] = BlockType::GRASS;
+                else if (depth <= SURFACE_DEPTH)
+                    slice[y][x] = BlockType::DIRT;
+                else
+                    slice[y][x] = BlockType::STONE;
+            }
+        }
+
+        // Front to back in the linear layout, in the others the slice's blocks
+        // are spread over the bricks or curve segments it crosses
+        for (int y = 0; y < CHUNK_SIZE; y++) {
+            for (int x = 0; x < CHUNK_SIZE; x++) {
+                Block& block = blocks[Chunk::Index(x, y, z)];
+                block = Block(slice[y][x]);
+                occupancy.Add(block);
+            }
+        }
+    }
+
+    return occupancy;
+}
+
+bool DensityGenerator::Classify(int chunkX, int chunkY, int chunkZ, BlockType& type) {
+    // The two noise octaves stay within 1.5 * NOISE_AMPLITUDE of the surface, add a block of slack
+    HeightRange bounds = heightmapCache.Get(chunkX, chunkZ)->range;
+    float reach = NOISE_AMPLITUDE * 1.5f + 1.0f;
+    int bottom = chunkY * Chunk::CHUNK_SIZE;
+    int top = bottom + Chunk::CHUNK_SIZE - 1;
+
+    if (bottom > bounds.maxHeight + reach) {
+        type = BlockType::AIR;
+        return true;
+    }
+    // Also deep enough that the blocks directly around the chunk are stone too
+    if (top + 1 < bounds.minHeight - reach - SURFACE_DEPTH) {
+        type = BlockType::STONE;
+        return true;
+    }
+    return false;
+}
+
+void DensityGenerator::Retain(int centerX, int centerZ, int distance) {
+    heightmapCache.Retain(centerX, centerZ, distance);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "WorldGenerator.h"
+#include "HeightmapCache.h"
+#include "TerrainGenerator.h"
+
+// Solid wherever the density is positive. The density falls off with height above
+// the heightmap surface and is disturbed by 3D noise, which carves overhangs and
+// caves near the surface. Noise is only evaluated on a coarse lattice and
+// trilinearly interpolated to the blocks in between.
+class DensityGenerator : public WorldGenerator
+{
+public:
+    // Blocks between lattice samples, must divide CHUNK_SIZE
+    static const int LATTICE_SPACING = 4;
+    // Solid blocks under open air that are covered in grass and dirt
+    static const int SURFACE_DEPTH = 4;
+
+    DensityGenerator(TerrainGenerator* terrainGenerator, unsigned int seed = 0);
+
+    BlockOccupancy FillChunk(int chunkX, int chunkY, int chunkZ, Block* blocks) override;
+    bool Classify(int chunkX, int chunkY, int chunkZ, BlockType& type) override;
+    void Retain(int centerX, int centerZ, int distance) override;
+
+    float GetDensity(int x, int y, int z, float surfaceHeight) const;
+
+private:
+    const float NOISE_SIZE = 24.0f;
+    // How far in blocks the noise can move the surface up or down
+    const float NOISE_AMPLITUDE = 12.0f;
+
+    static const int LATTICE_X = Chunk::CHUNK_SIZE / LATTICE_SPACING + 1;
+    // Extra rows above the chunk to find how deep each block is under the surface
+    static const int LATTICE_Y = (Chunk::CHUNK_SIZE + SURFACE_DEPTH + LATTICE_SPACING - 1) / LATTICE_SPACING + 1;
+
+    unsigned int seed;
+    HeightmapCache heightmapCache;
+
+    float Noise(float x, float y, float z) const;
+};
@@ -0,0 +1,156 @@
+#include "EditJournal.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "Compression.h"
+
+static void PutUint32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t GetUint32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+EditJournal::EditJournal(const std::string& directory)
+    : currentPath(directory + "/journal.log"), rotatedPath(directory + "/journal.old.log") {
+    // Cut off a batch torn by a crash, otherwise new batches would land behind it
+    std::vector<BlockEdit> edits;
+    uint64_t validBytes = ReadFile(currentPath, edits);
+    std::error_code error;
+    auto fileSize = std::filesystem::file_size(currentPath, error);
+    if (!error && fileSize > validBytes)
+        std::filesystem::resize_file(currentPath, validBytes, error);
+
+    OpenCurrent();
+}
+
+void EditJournal::OpenCurrent() {
+    file.open(currentPath, std::ios::binary | std::ios::app);
+    if (!file.is_open())
+        std::cerr << "Error opening edit journal: " << currentPath << std::endl;
+
+    std::error_code error;
+    auto existing = std::filesystem::file_size(currentPath, error);
+    size = error ? 0 : existing;
+}
+
+void EditJournal::Append(const std::vector<BlockEdit>& edits) {
+    if (edits.empty())
+        return;
+
+    std::vector<uint8_t> batch(BATCH_HEADER_SIZE + edits.size() * EDIT_SIZE);
+    uint8_t* p = batch.data() + BATCH_HEADER_SIZE;
+    for (const BlockEdit& edit : edits) {
+        PutUint32(p, (uint32_t)edit.x);
+        PutUint32(p + 4, (uint32_t)edit.y);
+        PutUint32(p + 8, (uint32_t)edit.z);
+        p[12] = (uint8_t)edit.block.type;
+        memcpy(p + 13, edit.block.edgeData.edges, 4);
+        p += EDIT_SIZE;
+    }
+    PutUint32(batch.data(), (uint32_t)edits.size());
+    PutUint32(batch.data() + 4, Compression::Crc32(batch.data() + BATCH_HEADER_SIZE, batch.size() - BATCH_HEADER_SIZE));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file.write((const char*)batch.data(), batch.size());
+    file.flush();
+    if (!file) {
+        file.clear();
+        std::cerr << "Error writing edit journal: " << currentPath << std::endl;
+        return;
+    }
+    size += batch.size();
+}
+
+void EditJournal::Rotate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+
+    std::error_code error;
+    if (std::filesystem::exists(rotatedPath, error)) {
+        // The last fold didn't finish, keep its edits ahead of the newer ones
+        std::ifstream in(currentPath, std::ios::binary);
+        std::ofstream out(rotatedPath, std::ios::binary | std::ios::app);
+        out << in.rdbuf();
+        in.close();
+        out.close();
+        std::filesystem::remove(currentPath, error);
+    }
+    else {
+        std::filesystem::rename(currentPath, rotatedPath, error);
+    }
+
+    OpenCurrent();
+}
+
+void EditJournal::DiscardRotated() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code error;
+    std::filesystem::remove(rotatedPath, error);
+}
+
+void EditJournal::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+
+    std::error_code error;
+    std::filesystem::remove(rotatedPath, error);
+    std::filesystem::remove(currentPath, error);
+
+    OpenCurrent();
+}
+
+void EditJournal::ReadAll(std::vector<BlockEdit>& edits) {
+    std::lock_guard<std::mutex> lock(mutex);
+    edits.clear();
+    ReadFile(rotatedPath, edits);
+    ReadFile(currentPath, edits);
+}
+
+uint64_t EditJournal::GetSize() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return size;
+}
+
+uint64_t EditJournal::ReadFile(const std::string& path, std::vector<BlockEdit>& edits) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return 0;
+
+    uint64_t validBytes = 0;
+    uint8_t header[BATCH_HEADER_SIZE];
+    std::vector<uint8_t> batch;
+    while (in.read((char*)header, sizeof(header))) {
+        uint32_t count = GetUint32(header);
+        if (count > MAX_BATCH_EDITS) {
+            std::cerr << "Edit journal " << path << " is corrupt, dropping the rest of it" << std::endl;
+            return validBytes;
+        }
+        batch.resize((size_t)count * EDIT_SIZE);
+        if (!in.read((char*)batch.data(), batch.size()) || GetUint32(header + 4) != Compression::Crc32(batch.data(), batch.size())) {
+            std::cerr << "Edit journal " << path << " ends in an incomplete batch, dropping it" << std::endl;
+            return validBytes;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* p = &batch[i * EDIT_SIZE];
+            if (p[12] > (uint8_t)BlockType::STONE)
+                continue;
+
+            BlockEdit edit;
+            edit.x = (int)GetUint32(p);
+            edit.y = (int)GetUint32(p + 4);
+            edit.z = (int)GetUint32(p + 8);
+            edit.block.type = (BlockType)p[12];
+            memcpy(edit.block.edgeData.edges, p + 13, 4);
+            edits.push_back(edit);
+        }
+        validBytes += BATCH_HEADER_SIZE + batch.size();
+    }
+
+    return validBytes;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Block.h"
+
+struct BlockEdit {
+    int x, y, z; // World block coordinates
+    Block block;
+};
+
+// Write-ahead log of block edits. The world hands each batch of edits to ChunkIO,
+// which appends it on its own thread and hands it to the OS, so a crash loses at
+// most the batches still queued there. Saved chunks plus the journal always give
+// the latest world: the journal is rotated before dirty chunks are written to
+// region files and the rotated file is only deleted once they all made it.
+class EditJournal
+{
+public:
+    EditJournal(const std::string& directory);
+
+    void Append(const std::vector<BlockEdit>& edits);
+
+    // Moves the current journal aside, later edits go to a fresh one
+    void Rotate();
+    // Deletes the rotated journal once its edits are in the region files
+    void DiscardRotated();
+    void Clear();
+
+    // Every edit in the rotated and current journal, oldest first. Reading stops
+    // at the first incomplete or corrupt batch.
+    void ReadAll(std::vector<BlockEdit>& edits);
+
+    // Bytes appended to the current journal
+    uint64_t GetSize();
+
+private:
+    // Count, checksum, then per edit x, y, z, type and edges
+    static const size_t BATCH_HEADER_SIZE = 8;
+    static const size_t EDIT_SIZE = 17;
+    // No real batch comes close, anything larger is a corrupt count
+    static const uint32_t MAX_BATCH_EDITS = 1 << 24;
+
+    std::string currentPath;
+    std::string rotatedPath;
+
+    std::mutex mutex;
+    std::ofstream file;
+    uint64_t size = 0;
+
+    void OpenCurrent();
+    // Returns how many bytes at the start of the file are complete batches
+    static uint64_t ReadFile(const std::string& path, std::vector<BlockEdit>& edits);
+};
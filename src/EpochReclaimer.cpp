@@ -0,0 +1,53 @@
+#include "EpochReclaimer.h"
+
+int EpochReclaimer::RegisterReader() {
+    for (int reader = 0; reader < MAX_READERS; reader++) {
+        bool expected = false;
+        if (registered[reader].compare_exchange_strong(expected, true))
+            return reader;
+    }
+    return -1;
+}
+
+void EpochReclaimer::UnregisterReader(int reader) {
+    if (reader < 0)
+        return;
+    readerEpochs[reader].store(NO_EPOCH);
+    registered[reader].store(false);
+}
+
+void EpochReclaimer::Enter(int reader) {
+    if (reader < 0)
+        return;
+
+    // A retire between reading the epoch and publishing it could have checked this
+    // slot already, publishing again until the epoch holds still closes that gap
+    uint64_t current = epoch.load();
+    for (;;) {
+        readerEpochs[reader].store(current);
+        uint64_t after = epoch.load();
+        if (after == current)
+            break;
+        current = after;
+    }
+}
+
+void EpochReclaimer::Leave(int reader) {
+    if (reader < 0)
+        return;
+    readerEpochs[reader].store(NO_EPOCH);
+}
+
+uint64_t EpochReclaimer::Retire() {
+    return epoch.fetch_add(1);
+}
+
+bool EpochReclaimer::IsReclaimable(uint64_t retireEpoch) const {
+    // Readers that entered after the retire can't have found what it covered
+    for (int reader = 0; reader < MAX_READERS; reader++) {
+        uint64_t readerEpoch = readerEpochs[reader].load();
+        if (readerEpoch != NO_EPOCH && readerEpoch <= retireEpoch)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Epoch based reclamation for objects other threads only know by raw pointer.
+// A reader thread registers once and marks the stretches of work that hold such
+// pointers with a Scope. Between scopes it's at a quiescent point and holds none.
+//
+// The owner unlinks an object so no new reader can find it, then retires it, which
+// returns the epoch to keep with it and moves the epoch on. The object may be
+// reused or destroyed once IsReclaimable says every reader has been quiescent
+// since, until then readers that found it earlier can still be using it.
+//
+// Registering is rare and takes a slot out of a fixed table, everything else is
+// lock free and safe to call from any thread.
+class EpochReclaimer
+{
+public:
+    static const int MAX_READERS = 16;
+    // Never a current epoch, so it can stand for "nothing recorded"
+    static const uint64_t NO_EPOCH = 0;
+
+    EpochReclaimer() = default;
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    // -1 if every slot is taken, a reader without a slot can't hold pointers
+    int RegisterReader();
+    void UnregisterReader(int reader);
+
+    // The reader's pointers are safe from the moment Enter returns until Leave
+    void Enter(int reader);
+    void Leave(int reader);
+
+    // Call once the objects are unlinked, one retire can cover any number of them
+    uint64_t Retire();
+    bool IsReclaimable(uint64_t retireEpoch) const;
+    uint64_t GetEpoch() const { return epoch.load(); }
+
+    class Scope
+    {
+    public:
+        Scope(EpochReclaimer& reclaimer, int reader) : reclaimer(reclaimer), reader(reader) { reclaimer.Enter(reader); }
+        ~Scope() { reclaimer.Leave(reader); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        EpochReclaimer& reclaimer;
+        int reader;
+    };
+
+private:
+    std::atomic<uint64_t> epoch{ 1 };
+    // Epoch each reader entered at, NO_EPOCH while it's quiescent
+    std::atomic<uint64_t> readerEpochs[MAX_READERS] = {};
+    std::atomic<bool> registered[MAX_READERS] = {};
+};
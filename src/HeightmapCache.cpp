@@ -0,0 +1,66 @@
+#include "HeightmapCache.h"
+
+#include <float.h>
+
+HeightmapCache::HeightmapCache(TerrainGenerator* terrainGenerator, size_t capacity)
+    : terrainGenerator(terrainGenerator), capacity(capacity) {}
+
+std::shared_ptr<const Heightmap> HeightmapCache::Get(int chunkX, int chunkZ) {
+    auto key = std::make_tuple(chunkX, 0, chunkZ);
+    std::promise<std::shared_ptr<const Heightmap>> promise;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto search = entries.find(key);
+    if (search != entries.end()) {
+        lru.splice(lru.begin(), lru, search->second.lruPosition);
+        auto heightmap = search->second.heightmap;
+        lock.unlock();
+        return heightmap.get();
+    }
+
+    lru.push_front(key);
+    entries[key] = Entry{ promise.get_future().share(), lru.begin() };
+
+    while (entries.size() > capacity) {
+        entries.erase(lru.back());
+        lru.pop_back();
+    }
+    lock.unlock();
+
+    auto heightmap = Generate(chunkX, chunkZ);
+    promise.set_value(heightmap);
+    return heightmap;
+}
+
+void HeightmapCache::Retain(int centerX, int centerZ, int distance) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto iterator = entries.begin(); iterator != entries.end();) {
+        if (abs(std::get<0>(iterator->first) - centerX) > distance || abs(std::get<2>(iterator->first) - centerZ) > distance) {
+            lru.erase(iterator->second.lruPosition);
+            iterator = entries.erase(iterator);
+        }
+        else {
+            ++iterator;
+        }
+    }
+}
+
+size_t HeightmapCache::Size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+std::shared_ptr<const Heightmap> HeightmapCache::Generate(int chunkX, int chunkZ) {
+    auto heightmap = std::make_shared<Heightmap>();
+
+    terrainGenerator->GetHeights(chunkX * Chunk::CHUNK_SIZE - Heightmap::BORDER, chunkZ * Chunk::CHUNK_SIZE - Heightmap::BORDER,
+        Heightmap::SIZE, Heightmap::SIZE, heightmap->heights);
+
+    heightmap->range = { FLT_MAX, -FLT_MAX };
+    for (float height : heightmap->heights) {
+        if (height < heightmap->range.minHeight) heightmap->range.minHeight = height;
+        if (height > heightmap->range.maxHeight) heightmap->range.maxHeight = height;
+    }
+
+    return heightmap;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <tuple>
+
+#include "Chunk.h"
+#include "TerrainGenerator.h"
+
+// Surface heights for one chunk column, with a one sample border all around so the
+// blocks of neighbouring columns that touch this one are covered as well
+struct Heightmap {
+    static const int BORDER = 1;
+    static const int SIZE = Chunk::CHUNK_SIZE + 1 + 2 * BORDER;
+
+    float heights[SIZE * SIZE]; // [z][x], starting at -BORDER
+    HeightRange range;
+
+    float Get(int x, int z) const { return heights[(z + BORDER) * SIZE + x + BORDER]; }
+};
+
+// Heightmaps shared by every vertical chunk of a column, so each column is only
+// sampled once. Safe to use from multiple threads; a column requested while another
+// thread is generating it waits for that result instead of generating it twice.
+class HeightmapCache
+{
+public:
+    static const size_t DEFAULT_CAPACITY = 4096;
+
+    HeightmapCache(TerrainGenerator* terrainGenerator, size_t capacity = DEFAULT_CAPACITY);
+
+    std::shared_ptr<const Heightmap> Get(int chunkX, int chunkZ);
+
+    // Drops columns further than distance chunks from the center column
+    void Retain(int centerX, int centerZ, int distance);
+
+    size_t Size();
+
+private:
+    typedef std::tuple<int, int, int> Key;
+
+    struct Entry {
+        std::shared_future<std::shared_ptr<const Heightmap>> heightmap;
+        std::list<Key>::iterator lruPosition;
+    };
+
+    TerrainGenerator* terrainGenerator;
+    size_t capacity;
+
+    std::mutex mutex;
+    std::unordered_map<Key, Entry, hash_tuple> entries;
+    std::list<Key> lru; // Most recently used at the front
+
+    std::shared_ptr<const Heightmap> Generate(int chunkX, int chunkZ);
+};
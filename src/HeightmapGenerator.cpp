@@ -0,0 +1,129 @@
+#include "HeightmapGenerator.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include "Chunk.h"
+
+HeightmapGenerator::HeightmapGenerator(TerrainGenerator* terrainGenerator) : heightmapCache(terrainGenerator) {}
+
+BlockOccupancy HeightmapGenerator::FillChunk(int chunkX, int chunkY, int chunkZ, Block* blocks) {
+    const int CHUNK_SIZE = Chunk::CHUNK_SIZE;
+    const int ROW = CHUNK_SIZE; // Blocks between consecutive y in the Chunk::Index layout
+    auto heightmap = heightmapCache.Get(chunkX, chunkZ);
+    int bottom = chunkY * CHUNK_SIZE;
+    BlockOccupancy occupancy;
+
+    // Each column is stone up to stoneEnd, dirt up to dirtEnd and air above, in local y,
+    // except for a single grass block at grassY. All indexed [z][x].
+    int stoneEnd[CHUNK_SIZE][CHUNK_SIZE], dirtEnd[CHUNK_SIZE][CHUNK_SIZE], grassY[CHUNK_SIZE][CHUNK_SIZE];
+    Block grass[CHUNK_SIZE][CHUNK_SIZE];
+    // Per z slice, rows below solidRows are all stone and rows from openRows up all air
+    int solidRows[CHUNK_SIZE], openRows[CHUNK_SIZE];
+
+    for (int z = 0; z < CHUNK_SIZE; z++)
+    {
+        solidRows[z] = CHUNK_SIZE;
+        openRows[z] = 0;
+
+        for (int x = 0; x < CHUNK_SIZE; x++)
+        {
+            const float smoothness = 8.0f;
+
+            float worldHeight1 = round(heightmap->Get(x, z + 1) * smoothness) / smoothness;
+            float worldHeight2 = round(heightmap->Get(x + 1, z) * smoothness) / smoothness;
+            float worldHeight3 = round(heightmap->Get(x, z) * smoothness) / smoothness;
+            float worldHeight4 = round(heightmap->Get(x + 1, z + 1) * smoothness) / smoothness;
+
+            float minHeight1 = worldHeight1 < worldHeight2 ? worldHeight1 : worldHeight2;
+            float minHeight2 = worldHeight3 < worldHeight4 ? worldHeight3 : worldHeight4;
+            int minHeight = static_cast<int>(floor(minHeight1 < minHeight2 ? minHeight1 : minHeight2));
+            int surfaceY = minHeight - bottom;
+
+            stoneEnd[z][x] = std::min(std::max(surfaceY - DIRT_DEPTH, 0), CHUNK_SIZE);
+            dirtEnd[z][x] = std::min(std::max(surfaceY, 0), CHUNK_SIZE);
+            grassY[z][x] = -1;
+
+            if (surfaceY >= 0 && surfaceY < CHUNK_SIZE) {
+                EdgeData edges = EdgeData();
+                edges.SetTopY(0, static_cast<int>((worldHeight1 - minHeight) * 8));
+                edges.SetTopY(1, static_cast<int>((worldHeight2 - minHeight) * 8));
+                edges.SetTopY(2, static_cast<int>((worldHeight3 - minHeight) * 8));
+                edges.SetTopY(3, static_cast<int>((worldHeight4 - minHeight) * 8));
+
+                if (edges.IsValid()) {
+                    grass[z][x] = Block(BlockType::GRASS);
+                    grass[z][x].SetEdgeData(edges);
+                    grassY[z][x] = surfaceY;
+                }
+                else if (surfaceY > 0) { // Workaround so it doesn't set a block at a negative y
+                    grass[z][x] = Block(BlockType::GRASS);
+                    grassY[z][x] = surfaceY - 1;
+                }
+            }
+
+            solidRows[z] = std::min(solidRows[z], stoneEnd[z][x]);
+            openRows[z] = std::max(openRows[z], std::max(dirtEnd[z][x], grassY[z][x] + 1));
+        }
+    }
+
+    auto columnBlock = [&](int x, int y, int z) {
+        if (y == grassY[z][x])
+            return grass[z][x];
+        if (y < stoneEnd[z][x])
+            return Block(BlockType::STONE);
+        if (y < dirtEnd[z][x])
+            return Block(BlockType::DIRT);
+        return Block(BlockType::AIR);
+    };
+
+    if constexpr (ChunkDimensions::ORDER == BlockOrder::Linear) {
+        for (int z = 0; z < CHUNK_SIZE; z++)
+        {
+            // Rows of a z slice are contiguous, so the stone under the lowest column and
+            // the air over the highest one are single range fills
+            Block* slice = blocks + Chunk::Index(0, 0, z);
+            FillRange(slice, 0, solidRows[z] * ROW, Block(BlockType::STONE), occupancy);
+            FillRange(slice, openRows[z] * ROW, CHUNK_SIZE * ROW, Block(BlockType::AIR), occupancy);
+
+            for (int y = solidRows[z]; y < openRows[z]; y++)
+            {
+                Block* row = slice + y * ROW;
+                for (int x = 0; x < CHUNK_SIZE; x++)
+                {
+                    row[x] = columnBlock(x, y, z);
+                    occupancy.Add(row[x]);
+                }
+            }
+        }
+    }
+    else {
+        // Slices aren't contiguous in the other layouts, they're written in memory order instead
+        ChunkDimensions::ForEachVoxel([&](int x, int y, int z, int index) {
+            blocks[index] = columnBlock(x, y, z);
+            occupancy.Add(blocks[index]);
+        });
+    }
+
+    return occupancy;
+}
+
+bool HeightmapGenerator::Classify(int chunkX, int chunkY, int chunkZ, BlockType& type) {
+    HeightRange bounds = heightmapCache.Get(chunkX, chunkZ)->range;
+    int bottom = chunkY * Chunk::CHUNK_SIZE;
+    int top = bottom + Chunk::CHUNK_SIZE - 1;
+
+    if (bottom > (int)ceil(bounds.maxHeight) + 1) {
+        type = BlockType::AIR;
+        return true;
+    }
+    if (top < (int)floor(bounds.minHeight) - SOLID_CHUNK_DEPTH) {
+        type = BlockType::STONE;
+        return true;
+    }
+    return false;
+}
+
+void HeightmapGenerator::Retain(int centerX, int centerZ, int distance) {
+    heightmapCache.Retain(centerX, centerZ, distance);
+}
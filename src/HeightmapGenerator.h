@@ -0,0 +1,24 @@
+#pragma once
+
+#include "WorldGenerator.h"
+#include "HeightmapCache.h"
+#include "TerrainGenerator.h"
+
+// Grass, dirt and stone layered under a smooth 2D heightmap surface
+class HeightmapGenerator : public WorldGenerator
+{
+public:
+    // Chunks whose top is at least this many blocks under the lowest surface
+    // point around their column are solid all the way through and fully enclosed
+    static const int SOLID_CHUNK_DEPTH = 7;
+    static const int DIRT_DEPTH = 4;
+
+    HeightmapGenerator(TerrainGenerator* terrainGenerator);
+
+    BlockOccupancy FillChunk(int chunkX, int chunkY, int chunkZ, Block* blocks) override;
+    bool Classify(int chunkX, int chunkY, int chunkZ, BlockType& type) override;
+    void Retain(int centerX, int centerZ, int distance) override;
+
+private:
+    HeightmapCache heightmapCache;
+};
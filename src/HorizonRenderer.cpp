@@ -0,0 +1,167 @@
+#include "HorizonRenderer.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int Wrap(int a, int b) {
+    return ((a % b) + b) % b;
+}
+
+HorizonRenderer::HorizonRenderer(TerrainGenerator* terrainGenerator) : terrainGenerator(terrainGenerator) {
+    for (int i = 0; i < LEVEL_COUNT; i++)
+        levels[i].spacing = BASE_SPACING << i;
+
+    glGenTextures(1, &heightTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, GRID_SIZE, GRID_SIZE, LEVEL_COUNT, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // One grid shared by every level, the vertex shader finds its sample from gl_VertexID
+    std::vector<uint32_t> indices;
+    indices.reserve((GRID_SIZE - 1) * (GRID_SIZE - 1) * 6);
+    for (int z = 0; z < GRID_SIZE - 1; z++) {
+        for (int x = 0; x < GRID_SIZE - 1; x++) {
+            uint32_t corner = z * GRID_SIZE + x;
+            indices.push_back(corner);
+            indices.push_back(corner + GRID_SIZE);
+            indices.push_back(corner + 1);
+            indices.push_back(corner + 1);
+            indices.push_back(corner + GRID_SIZE);
+            indices.push_back(corner + GRID_SIZE + 1);
+        }
+    }
+    indexCount = (GLsizei)indices.size();
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &ebo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+HorizonRenderer::~HorizonRenderer() {
+    glDeleteTextures(1, &heightTexture);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &ebo);
+}
+
+void HorizonRenderer::Update(const glm::vec3& cameraPosition) {
+    int cameraX = (int)std::floor(cameraPosition.x);
+    int cameraZ = (int)std::floor(cameraPosition.z);
+
+    for (int i = 0; i < LEVEL_COUNT; i++) {
+        Level& level = levels[i];
+
+        // Even origins keep every coarse sample on top of a finer one
+        int originX = (FloorDiv(cameraX, level.spacing) - GRID_SIZE / 2) & ~1;
+        int originZ = (FloorDiv(cameraZ, level.spacing) - GRID_SIZE / 2) & ~1;
+        int dx = originX - level.originX;
+        int dz = originZ - level.originZ;
+
+        if (!level.valid || abs(dx) >= GRID_SIZE || abs(dz) >= GRID_SIZE) {
+            UpdateRegion(i, originX, originZ, GRID_SIZE, GRID_SIZE);
+        }
+        else {
+            // Columns that came into range over the whole new height, then rows
+            // over the whole new width, which samples the corner twice
+            if (dx > 0)
+                UpdateRegion(i, level.originX + GRID_SIZE, originZ, dx, GRID_SIZE);
+            else if (dx < 0)
+                UpdateRegion(i, originX, originZ, -dx, GRID_SIZE);
+
+            if (dz > 0)
+                UpdateRegion(i, originX, level.originZ + GRID_SIZE, GRID_SIZE, dz);
+            else if (dz < 0)
+                UpdateRegion(i, originX, originZ, GRID_SIZE, -dz);
+        }
+
+        level.originX = originX;
+        level.originZ = originZ;
+        level.valid = true;
+    }
+}
+
+void HorizonRenderer::UpdateRegion(int level, int x0, int z0, int width, int depth) {
+    int spacing = levels[level].spacing;
+    heights.resize((size_t)width * depth);
+    terrainGenerator->GetHeights(x0 * spacing, z0 * spacing, width, depth, heights.data(), spacing);
+    sampleCount += (uint64_t)width * depth;
+
+    // The region wraps around the layer at most once on each axis
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+
+    int texelX = Wrap(x0, GRID_SIZE), texelZ = Wrap(z0, GRID_SIZE);
+    int firstWidth = std::min(width, GRID_SIZE - texelX);
+    int firstDepth = std::min(depth, GRID_SIZE - texelZ);
+    const int pieceX[2][3] = { { texelX, 0, firstWidth }, { 0, firstWidth, width - firstWidth } };
+    const int pieceZ[2][3] = { { texelZ, 0, firstDepth }, { 0, firstDepth, depth - firstDepth } };
+
+    for (const auto& z : pieceZ) {
+        for (const auto& x : pieceX) {
+            if (x[2] == 0 || z[2] == 0)
+                continue;
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, x[1]);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, z[1]);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x[0], z[0], level, x[2], z[2], 1, GL_RED, GL_FLOAT, heights.data());
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void HorizonRenderer::Render(Shader& shader, const glm::mat4& projection, glm::vec2 holeCenter, float holeHalfExtent, bool roundHole) {
+    if (!levels[0].valid)
+        return;
+
+    shader.Use();
+    shader.SetUniform("horizonProjection", projection);
+    glUniform1i(shader.GetUniformLocation("heights"), 0);
+    glUniform1i(shader.GetUniformLocation("gridSize"), GRID_SIZE);
+    glUniform4f(shader.GetUniformLocation("chunkHole"), holeCenter.x, holeCenter.y, holeHalfExtent, roundHole ? 1.0f : 0.0f);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+    glBindVertexArray(vao);
+
+    for (int i = 0; i < LEVEL_COUNT; i++) {
+        const Level& level = levels[i];
+        glUniform1i(shader.GetUniformLocation("level"), i);
+        glUniform1f(shader.GetUniformLocation("spacing"), (float)level.spacing);
+        glUniform2i(shader.GetUniformLocation("origin"), level.originX, level.originZ);
+        glUniform2i(shader.GetUniformLocation("texelOrigin"), Wrap(level.originX, GRID_SIZE), Wrap(level.originZ, GRID_SIZE));
+
+        // The finer level covers the middle, the finest leaves it empty
+        if (i > 0) {
+            const Level& inner = levels[i - 1];
+            float extent = (float)((GRID_SIZE - 1) * inner.spacing);
+            glUniform4f(shader.GetUniformLocation("levelHole"), (float)(inner.originX * inner.spacing), (float)(inner.originZ * inner.spacing),
+                inner.originX * inner.spacing + extent, inner.originZ * inner.spacing + extent);
+        }
+        else {
+            glUniform4f(shader.GetUniformLocation("levelHole"), 0.0f, 0.0f, 0.0f, 0.0f);
+        }
+
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
+    }
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+size_t HorizonRenderer::GetMemoryUsage() const {
+    return (size_t)LEVEL_COUNT * GRID_SIZE * GRID_SIZE * sizeof(float) + (size_t)indexCount * sizeof(uint32_t);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "TerrainGenerator.h"
+
+class Shader;
+
+// Terrain past the loaded chunks, drawn straight from TerrainGenerator heights
+// without any chunks or blocks. The heights are a clipmap: nested square grids of
+// GRID_SIZE samples, each level twice as coarse and twice as wide as the one
+// inside it, all centred on the camera. Each level lives in one layer of a texture
+// array and is addressed toroidally, so when the camera moves only the rows and
+// columns that came into range are sampled and uploaded. Memory stays fixed no
+// matter how far the horizon reaches.
+//
+// Everything here has to be called on the render thread.
+class HorizonRenderer
+{
+public:
+    static const int LEVEL_COUNT = 6;
+    static const int GRID_SIZE = 64;
+    // Blocks between samples on the finest level, the coarsest is 2^(LEVEL_COUNT - 1) times that
+    static const int BASE_SPACING = 8;
+
+    HorizonRenderer(TerrainGenerator* terrainGenerator);
+    ~HorizonRenderer();
+    HorizonRenderer(const HorizonRenderer&) = delete;
+    HorizonRenderer& operator=(const HorizonRenderer&) = delete;
+
+    // Moves the levels along with the camera
+    void Update(const glm::vec3& cameraPosition);
+
+    // Leaves out the area of loaded chunks, a square or circle of holeHalfExtent
+    // blocks around holeCenter. Uses its own projection since the horizon reaches
+    // well past the chunks' far plane, so the depth buffer has to be cleared before
+    // the chunks are drawn over it.
+    void Render(Shader& shader, const glm::mat4& projection, glm::vec2 holeCenter, float holeHalfExtent, bool roundHole);
+
+    // Distance to the edge of the coarsest level
+    float GetViewDistance() const { return (float)(GRID_SIZE / 2) * (BASE_SPACING << (LEVEL_COUNT - 1)); }
+    size_t GetMemoryUsage() const;
+    // Heights sampled since the start, full refreshes included
+    uint64_t GetSampleCount() const { return sampleCount; }
+
+private:
+    struct Level {
+        int spacing;
+        int originX = 0, originZ = 0; // First sample of the grid, in samples
+        bool valid = false;
+    };
+
+    TerrainGenerator* terrainGenerator;
+    Level levels[LEVEL_COUNT];
+    std::vector<float> heights; // Scratch for one update
+    uint64_t sampleCount = 0;
+
+    GLuint heightTexture = 0;
+    GLuint vao = 0, ebo = 0;
+    GLsizei indexCount = 0;
+
+    // Samples the region, given in samples, and writes it to its wrapped place in the level's layer
+    void UpdateRegion(int level, int x0, int z0, int width, int depth);
+};
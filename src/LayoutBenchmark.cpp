@@ -0,0 +1,148 @@
+#include "LayoutBenchmark.h"
+
+#include <chrono>
+#include <iostream>
+
+// Typical desktop L1 data and L2 caches
+static const size_t L1_BYTES = 32 * 1024;
+static const int L1_WAYS = 8;
+static const size_t L2_BYTES = 1024 * 1024;
+static const int L2_WAYS = 16;
+
+SimulatedCache::SimulatedCache(size_t bytes, int ways)
+    : ways(ways), setCount(bytes / (LINE_SIZE * ways)), lines(setCount * ways, 0) {}
+
+bool SimulatedCache::Access(uint64_t address) {
+    uint64_t line = address / LINE_SIZE;
+    uint64_t* set = &lines[(line % setCount) * ways];
+
+    // Found or not, the line ends up in front and the ways before it move back one
+    int way = 0;
+    while (way < ways - 1 && set[way] != line + 1)
+        way++;
+    bool miss = set[way] != line + 1;
+    for (; way > 0; way--)
+        set[way] = set[way - 1];
+    set[0] = line + 1;
+    return miss;
+}
+
+static const int kBenchmarkNeighbourOffsets[6][3] = {
+    { 1, 0, 0 }, {-1, 0, 0 },
+    { 0, 1, 0 }, { 0,-1, 0 },
+    { 0, 0, 1 }, { 0, 0,-1 },
+};
+
+// The mesher's culling pass without the vertices: every solid block reads its six
+// neighbours, walking the chunk in memory order. read(index) sees every block read.
+// Returns the faces it would add.
+template <BlockOrder Order, typename Read>
+static uint64_t CountVisibleFaces(const Block* blocks, Read&& read) {
+    using Layout = ChunkLayout<ChunkDimensions::SIZE, Order>;
+    uint64_t faces = 0;
+    Layout::ForEachVoxel([&](int x, int y, int z, int index) {
+        read(index);
+        if (blocks[index].type == BlockType::AIR) return;
+        bool full = blocks[index].IsFullBlock();
+        for (const auto& offset : kBenchmarkNeighbourOffsets) {
+            int nx = x + offset[0], ny = y + offset[1], nz = z + offset[2];
+            bool inside = nx >= 0 && nx < Layout::SIZE && ny >= 0 && ny < Layout::SIZE && nz >= 0 && nz < Layout::SIZE;
+            if (!inside || !full)
+                faces++;
+            else {
+                int neighbour = Layout::Index(nx, ny, nz);
+                read(neighbour);
+                if (!blocks[neighbour].IsFullBlock())
+                    faces++;
+            }
+        }
+    });
+    return faces;
+}
+
+// Times the pass over chunks stored in the given order, then runs it once more
+// through the simulated caches. linear holds the chunks in the linear order.
+template <BlockOrder Order>
+static void MeasureBlockLayout(const std::vector<Block>& linear, BlockLayoutBenchmark& result, uint64_t& faces) {
+    using Layout = ChunkLayout<ChunkDimensions::SIZE, Order>;
+    const int chunkCount = (int)(linear.size() / Layout::VOLUME);
+    const int passes = 4;
+
+    std::vector<Block> blocks(linear.size());
+    for (int c = 0; c < chunkCount; c++) {
+        for (int i = 0; i < Layout::VOLUME; i++)
+            blocks[c * Layout::VOLUME + Layout::FromLinear(i)] = linear[c * Layout::VOLUME + i];
+    }
+
+    faces = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int pass = 0; pass < passes; pass++) {
+        for (int c = 0; c < chunkCount; c++)
+            faces += CountVisibleFaces<Order>(&blocks[c * Layout::VOLUME], [](int) {});
+    }
+    std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start;
+    result.nanosecondsPerBlock[(int)Order] = time.count() * 1e9 / ((double)passes * linear.size());
+
+    // Addresses are offsets into the blocks, as if the array started on a line
+    SimulatedCache l1(L1_BYTES, L1_WAYS), l2(L2_BYTES, L2_WAYS);
+    uint64_t l1Misses = 0, l2Misses = 0;
+    for (int c = 0; c < chunkCount; c++) {
+        uint64_t chunkStart = (uint64_t)c * Layout::VOLUME;
+        CountVisibleFaces<Order>(&blocks[chunkStart], [&](int index) {
+            uint64_t address = (chunkStart + index) * sizeof(Block);
+            if (l1.Access(address)) {
+                l1Misses++;
+                if (l2.Access(address))
+                    l2Misses++;
+            }
+        });
+    }
+    result.l1MissesPerBlock[(int)Order] = (double)l1Misses / linear.size();
+    result.l2MissesPerBlock[(int)Order] = (double)l2Misses / linear.size();
+}
+
+// The chunks together take about 64 MB, several times the size of a desktop L3
+// cache, so the times mostly show how well each order keeps neighbour reads in
+// lines that are already loaded. The simulated misses show the same without the
+// noise of the machine.
+BlockLayoutBenchmark BenchmarkBlockLayouts(WorldGenerator& worldGenerator, int surfaceChunkY) {
+    const int layers = 4;
+    const int volume = ChunkDimensions::VOLUME;
+
+    // Widest square of columns that stays within the target at this chunk size
+    const size_t targetBytes = (size_t)64 * 1024 * 1024;
+    const size_t chunkBytes = (size_t)volume * sizeof(Block);
+    int side = 1;
+    while ((size_t)(side + 1) * (side + 1) * layers * chunkBytes <= targetBytes)
+        side++;
+
+    std::vector<Block> filled(volume);
+    std::vector<Block> linear;
+    linear.reserve((size_t)side * side * layers * volume);
+    for (int cz = 0; cz < side; cz++) {
+        for (int cx = 0; cx < side; cx++) {
+            for (int cy = surfaceChunkY - layers / 2; cy < surfaceChunkY + layers / 2; cy++) {
+                worldGenerator.FillChunk(cx, cy, cz, filled.data());
+                for (int i = 0; i < volume; i++)
+                    linear.push_back(filled[ChunkDimensions::FromLinear(i)]);
+            }
+        }
+    }
+
+    BlockLayoutBenchmark result;
+    uint64_t faces[3];
+    MeasureBlockLayout<BlockOrder::Linear>(linear, result, faces[0]);
+    MeasureBlockLayout<BlockOrder::Brick>(linear, result, faces[1]);
+    MeasureBlockLayout<BlockOrder::Morton>(linear, result, faces[2]);
+    result.identical = faces[0] == faces[1] && faces[0] == faces[2];
+    result.done = true;
+
+    const char* names[3] = { "linear", "brick", "Morton" };
+    std::cout << "Block layouts over " << side * side * layers << " chunks" << (result.identical ? "" : " (MISMATCH)") << std::endl;
+    for (int order = 0; order < 3; order++) {
+        std::cout << "  " << names[order] << ": " << result.nanosecondsPerBlock[order] << " ns/block, "
+            << result.l1MissesPerBlock[order] << " L1 misses/block, " << result.l2MissesPerBlock[order] << " L2 misses/block" << std::endl;
+    }
+
+    return result;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "WorldGenerator.h"
+
+struct BlockLayoutBenchmark {
+    bool done = false;
+    bool identical = true; // Every layout found the same faces
+    // Of the mesher's neighbour pass, indexed by BlockOrder
+    double nanosecondsPerBlock[3] = {};
+    // Misses of the pass's reads in the simulated caches, so the comparison doesn't
+    // depend on the machine it runs on
+    double l1MissesPerBlock[3] = {};
+    double l2MissesPerBlock[3] = {};
+};
+
+// Set associative cache with LRU replacement that only keeps tags, fed the
+// addresses a pass reads
+class SimulatedCache
+{
+public:
+    static const int LINE_SIZE = 64;
+
+    SimulatedCache(size_t bytes, int ways);
+
+    // True if the line wasn't cached, it is afterwards
+    bool Access(uint64_t address);
+
+private:
+    int ways;
+    size_t setCount;
+    // Per set, most recently used first. Zero is an empty way, lines are stored plus one.
+    std::vector<uint64_t> lines;
+};
+
+// Compares the block orders on generated chunks around the surface, prints the
+// results and returns them
+BlockLayoutBenchmark BenchmarkBlockLayouts(WorldGenerator& worldGenerator, int surfaceChunkY);
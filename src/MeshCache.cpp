@@ -0,0 +1,113 @@
+#include "MeshCache.h"
+
+#include <cstring>
+
+static uint64_t Rotate(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Finalizer from MurmurHash3, every input bit affects every output bit
+static uint64_t Mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+void MeshCache::Hasher::Add(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    length += size;
+
+    // Two lanes with different multipliers over 8 bytes at a time
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        low = Rotate(low ^ (word * 0x87C37B91114253D5ull), 31) * 0x4CF5AD432745937Full;
+        high = Rotate(high + (word * 0x52DCE729ull), 27) * 0x9E3779B97F4A7C15ull;
+        bytes += 8;
+        size -= 8;
+    }
+
+    if (size > 0) {
+        uint64_t word = 0;
+        memcpy(&word, bytes, size);
+        word ^= (uint64_t)size << 56;
+        low = Rotate(low ^ (word * 0x87C37B91114253D5ull), 31) * 0x4CF5AD432745937Full;
+        high = Rotate(high + (word * 0x52DCE729ull), 27) * 0x9E3779B97F4A7C15ull;
+    }
+}
+
+MeshCache::Key MeshCache::Hasher::Finish() const {
+    uint64_t a = low ^ length, b = high ^ Rotate(length, 32);
+    a += b;
+    b += a;
+    return Key{ Mix(a), Mix(b) };
+}
+
+MeshCache::MeshCache(size_t capacity) : capacity(capacity) {}
+
+std::shared_ptr<const MeshCache::Mesh> MeshCache::Find(const Key& key, const Verifier& verifier) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto search = entries.find(key);
+    // A hash collision, the Insert after the caller builds its own mesh replaces it
+    if (search == entries.end() || !(search->second->second->verifier == verifier)) {
+        misses++;
+        return nullptr;
+    }
+
+    hits++;
+    recent.splice(recent.begin(), recent, search->second);
+    return search->second->second;
+}
+
+void MeshCache::Insert(const Key& key, std::shared_ptr<const Mesh> mesh) {
+    size_t size = GetSize(*mesh);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size > capacity)
+        return;
+
+    // Two threads can build the same mesh, the later one just refreshes it
+    auto search = entries.find(key);
+    if (search != entries.end()) {
+        bytes -= GetSize(*search->second->second);
+        recent.erase(search->second);
+        entries.erase(search);
+    }
+
+    recent.emplace_front(key, std::move(mesh));
+    entries[key] = recent.begin();
+    bytes += size;
+    EvictToCapacity();
+}
+
+void MeshCache::SetCapacity(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = bytes;
+    EvictToCapacity();
+}
+
+void MeshCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    recent.clear();
+    entries.clear();
+    bytes = 0;
+}
+
+MeshCache::Stats MeshCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Stats{ hits, misses, entries.size(), bytes, capacity };
+}
+
+size_t MeshCache::GetSize(const Mesh& mesh) {
+    return sizeof(Mesh) + mesh.vertices.size() * sizeof(uint32_t);
+}
+
+void MeshCache::EvictToCapacity() {
+    while (bytes > capacity && !recent.empty()) {
+        bytes -= GetSize(*recent.back().second);
+        entries.erase(recent.back().first);
+        recent.pop_back();
+    }
+}
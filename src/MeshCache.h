@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "ChunkDrawList.h"
+
+// Finished chunk meshes by a hash of everything GenerateMesh reads: the chunk's
+// blocks, its level of detail and which blocks on the borders of its neighbours
+// are full cubes. Chunks that come back with the same content, through the pool,
+// a reload or RebuildAllChunks, copy their mesh from here instead of building it.
+//
+// The cache is bounded by the size of the meshes it holds and drops the least
+// recently used ones first. Safe to use from any thread.
+class MeshCache
+{
+public:
+    static const size_t DEFAULT_CAPACITY = 64ull * 1024 * 1024;
+
+    // 128 bits of a fast non-cryptographic hash. Collisions are unlikely but not
+    // impossible, so a Verifier is compared on every hit as well.
+    struct Key {
+        uint64_t low, high;
+
+        bool operator==(const Key& other) const { return low == other.low && high == other.high; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return (size_t)key.low; }
+    };
+
+    // Builds a Key from any number of byte ranges
+    class Hasher {
+    public:
+        void Add(const void* data, size_t size);
+        Key Finish() const;
+
+    private:
+        uint64_t low = 0x9E3779B97F4A7C15ull, high = 0xC2B2AE3D27D4EB4Full;
+        uint64_t length = 0;
+    };
+
+    // Cheap facts about what the mesh was built from that the hash doesn't have to
+    // get right. A colliding chunk would have to match these too to show the wrong mesh.
+    struct Verifier {
+        int solidCount, fullCount;
+        int lodLevel;
+
+        bool operator==(const Verifier& other) const {
+            return solidCount == other.solidCount && fullCount == other.fullCount && lodLevel == other.lodLevel;
+        }
+    };
+
+    struct Mesh {
+        std::vector<uint32_t> vertices;
+        ChunkDrawList::FaceRanges faceRanges;
+        Verifier verifier;
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t entryCount;
+        size_t bytes;
+        size_t capacity;
+    };
+
+    MeshCache(size_t capacity = DEFAULT_CAPACITY);
+
+    // Null on a miss, including a key whose mesh was built from something else
+    std::shared_ptr<const Mesh> Find(const Key& key, const Verifier& verifier);
+    void Insert(const Key& key, std::shared_ptr<const Mesh> mesh);
+    void SetCapacity(size_t bytes);
+    void Clear();
+    Stats GetStats() const;
+
+private:
+    using Entry = std::pair<Key, std::shared_ptr<const Mesh>>;
+
+    mutable std::mutex mutex;
+    std::list<Entry> recent; // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries;
+    size_t bytes = 0;
+    size_t capacity;
+    uint64_t hits = 0, misses = 0;
+
+    static size_t GetSize(const Mesh& mesh);
+    void EvictToCapacity();
+};
@@ -0,0 +1,227 @@
+#include "RegionFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "Compression.h"
+
+static const char REGION_MAGIC[4] = { 'V', 'X', 'R', 'G' };
+
+static void PutUint32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t GetUint32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+RegionFile::RegionFile(const std::string& path, uint32_t chunkSize) : path(path), chunkSize(chunkSize), table(ENTRY_COUNT, Entry{ 0, 0 }) {}
+
+RegionFile::~RegionFile() {
+    if (file.is_open())
+        file.close();
+}
+
+int RegionFile::EntryIndex(int localX, int localY, int localZ) {
+    return localX + REGION_SIZE * (localY + REGION_SIZE * localZ);
+}
+
+bool RegionFile::Open(bool create) {
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+        if (!create)
+            return false;
+
+        // Empty region: header with a zeroed offset table
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        std::vector<uint8_t> header(HEADER_SIZE, 0);
+        memcpy(header.data(), REGION_MAGIC, 4);
+        PutUint32(&header[4], VERSION);
+        PutUint32(&header[8], chunkSize);
+        out.write((const char*)header.data(), header.size());
+        if (!out) {
+            std::cerr << "Error creating region file: " << path << std::endl;
+            return false;
+        }
+    }
+
+    file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        std::cerr << "Error opening region file: " << path << std::endl;
+        return false;
+    }
+
+    uint8_t prefix[TABLE_OFFSET] = {};
+    file.read((char*)prefix, sizeof(prefix));
+    uint32_t version = GetUint32(&prefix[4]);
+    if (!file || memcmp(prefix, REGION_MAGIC, 4) != 0 || (version != VERSION && version != 1)) {
+        std::cerr << "Error reading region file: " << path << std::endl;
+        file.close();
+        return false;
+    }
+
+    // Version 1 regions were only ever written by builds with 16 block chunks
+    uint32_t fileChunkSize = version == 1 ? V1_CHUNK_SIZE : GetUint32(&prefix[8]);
+    if (fileChunkSize != chunkSize) {
+        std::cerr << "Region file holds chunks of " << fileChunkSize << " blocks, this build uses " << chunkSize << ": " << path << std::endl;
+        file.close();
+        return false;
+    }
+
+    tableOffset = version == 1 ? V1_TABLE_OFFSET : TABLE_OFFSET;
+    std::vector<uint8_t> header(GetHeaderSize());
+    file.seekg(0);
+    file.read((char*)header.data(), header.size());
+    if (!file) {
+        std::cerr << "Error reading region file: " << path << std::endl;
+        file.close();
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    fileEnd = (uint64_t)file.tellg();
+
+    uint64_t liveBytes = 0;
+    for (int i = 0; i < ENTRY_COUNT; i++) {
+        table[i].offset = GetUint32(&header[tableOffset + i * 8]);
+        table[i].size = GetUint32(&header[tableOffset + 4 + i * 8]);
+
+        // An entry pointing past the end was cut off mid write, treat it as absent
+        if (table[i].offset && (table[i].offset < GetHeaderSize() || (uint64_t)table[i].offset + table[i].size > fileEnd))
+            table[i] = Entry{ 0, 0 };
+        liveBytes += table[i].size;
+    }
+    deadBytes = fileEnd - GetHeaderSize() - liveBytes;
+
+    return true;
+}
+
+bool RegionFile::Has(int index) const {
+    return table[index].offset != 0;
+}
+
+bool RegionFile::Read(int index, std::vector<uint8_t>& payload) {
+    const Entry& entry = table[index];
+    if (!entry.offset || entry.size < 4)
+        return false;
+
+    std::vector<uint8_t> record(entry.size);
+    file.seekg(entry.offset);
+    file.read((char*)record.data(), record.size());
+    if (!file) {
+        file.clear();
+        return false;
+    }
+
+    if (GetUint32(record.data()) != Compression::Crc32(record.data() + 4, record.size() - 4)) {
+        std::cerr << "Corrupt chunk record in " << path << std::endl;
+        return false;
+    }
+
+    payload.assign(record.begin() + 4, record.end());
+    return true;
+}
+
+bool RegionFile::Write(int index, const std::vector<uint8_t>& payload) {
+    uint32_t size = (uint32_t)payload.size() + 4;
+    if (fileEnd + size > UINT32_MAX)
+        return false;
+
+    // The record goes in first, so the table never points at a partial record
+    std::vector<uint8_t> record(size);
+    PutUint32(record.data(), Compression::Crc32(payload.data(), payload.size()));
+    memcpy(record.data() + 4, payload.data(), payload.size());
+
+    file.seekp(fileEnd);
+    file.write((const char*)record.data(), record.size());
+    file.flush();
+    if (!file) {
+        file.clear();
+        std::cerr << "Error writing region file: " << path << std::endl;
+        return false;
+    }
+
+    deadBytes += table[index].size;
+    table[index] = Entry{ (uint32_t)fileEnd, size };
+    fileEnd += size;
+
+    if (!WriteEntry(index))
+        return false;
+
+    uint64_t liveBytes = fileEnd - GetHeaderSize() - deadBytes;
+    if (deadBytes > COMPACT_MIN_DEAD_BYTES && deadBytes > liveBytes)
+        Compact();
+
+    return true;
+}
+
+bool RegionFile::WriteEntry(int index) {
+    uint8_t bytes[8];
+    PutUint32(bytes, table[index].offset);
+    PutUint32(bytes + 4, table[index].size);
+
+    file.seekp(tableOffset + index * 8);
+    file.write((const char*)bytes, sizeof(bytes));
+    file.flush();
+    if (!file) {
+        file.clear();
+        std::cerr << "Error writing region file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RegionFile::Compact() {
+    std::string tempPath = path + ".tmp";
+    std::vector<Entry> compacted(ENTRY_COUNT, Entry{ 0, 0 });
+
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        std::vector<uint8_t> header(HEADER_SIZE, 0);
+        out.write((const char*)header.data(), header.size());
+
+        uint32_t offset = HEADER_SIZE;
+        std::vector<uint8_t> record;
+        for (int i = 0; i < ENTRY_COUNT; i++) {
+            if (!table[i].offset)
+                continue;
+
+            record.resize(table[i].size);
+            file.seekg(table[i].offset);
+            file.read((char*)record.data(), record.size());
+            if (!file) {
+                file.clear();
+                return false;
+            }
+
+            out.write((const char*)record.data(), record.size());
+            compacted[i] = Entry{ offset, table[i].size };
+            offset += table[i].size;
+        }
+
+        // Always rewritten in the current version
+        memcpy(header.data(), REGION_MAGIC, 4);
+        PutUint32(&header[4], VERSION);
+        PutUint32(&header[8], chunkSize);
+        for (int i = 0; i < ENTRY_COUNT; i++) {
+            PutUint32(&header[TABLE_OFFSET + i * 8], compacted[i].offset);
+            PutUint32(&header[TABLE_OFFSET + 4 + i * 8], compacted[i].size);
+        }
+        out.seekp(0);
+        out.write((const char*)header.data(), header.size());
+        if (!out) {
+            std::cerr << "Error compacting region file: " << path << std::endl;
+            return false;
+        }
+    }
+
+    file.close();
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+        std::cerr << "Error replacing region file: " << path << " (" << error.message() << ")" << std::endl;
+
+    return Open(false) && !error;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// One file holding up to REGION_SIZE^3 chunks. The file starts with a fixed size
+// header, the edge length of its chunks and a table giving the offset and size of
+// every chunk's record, followed by the records.
+// Records are only ever appended: rewriting a chunk leaves its old record behind
+// as dead space, which is reclaimed by rewriting the file once it outweighs the
+// live records.
+class RegionFile
+{
+public:
+    static const int REGION_SIZE = 16;
+    static const int ENTRY_COUNT = REGION_SIZE * REGION_SIZE * REGION_SIZE;
+    static const uint32_t VERSION = 2;
+
+    // Records hold chunks of chunkSize blocks, a region written for another size won't open
+    RegionFile(const std::string& path, uint32_t chunkSize);
+    ~RegionFile();
+
+    // Reads the offset table, creating an empty region first if create is set
+    bool Open(bool create);
+
+    static int EntryIndex(int localX, int localY, int localZ);
+
+    bool Has(int index) const;
+    // Fails if the chunk is absent or its record doesn't match its checksum
+    bool Read(int index, std::vector<uint8_t>& payload);
+    bool Write(int index, const std::vector<uint8_t>& payload);
+
+    // Rewrites the file with only the live records
+    bool Compact();
+
+    uint64_t GetFileSize() const { return fileEnd; }
+    uint64_t GetDeadBytes() const { return deadBytes; }
+
+private:
+    // Magic, version, chunk size and offset table
+    static const uint32_t TABLE_OFFSET = 12;
+    static const uint32_t HEADER_SIZE = TABLE_OFFSET + ENTRY_COUNT * 8;
+    // Version 1 had no chunk size, its table starts right after the version
+    static const uint32_t V1_TABLE_OFFSET = 8;
+    static const uint32_t V1_CHUNK_SIZE = 16;
+    // Dead space worth a rewrite, as long as it is also more than the live data
+    static const uint64_t COMPACT_MIN_DEAD_BYTES = 1024 * 1024;
+
+    struct Entry {
+        uint32_t offset; // 0 when the chunk isn't stored
+        uint32_t size;   // Checksum and payload
+    };
+
+    std::string path;
+    uint32_t chunkSize;
+    uint32_t tableOffset = TABLE_OFFSET;
+    std::fstream file;
+    std::vector<Entry> table;
+    uint64_t fileEnd = 0;
+    uint64_t deadBytes = 0;
+
+    bool WriteEntry(int index);
+    uint32_t GetHeaderSize() const { return tableOffset + ENTRY_COUNT * 8; }
+};
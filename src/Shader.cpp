@@ -19,6 +19,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
     else {
         Shader::shaderProgram = CreateDefaultShader();
     }
+    OnLinked();
 }
 
 //Shader::Shader(const unsigned char* vertexSource, int vertexSize, const unsigned char* fragmentSource, int fragmentSize) {
@@ -40,18 +41,20 @@ void Shader::Use() {
 }
 
 void Shader::SetUniform(const char* name, glm::mat4 matrix) {
-    unsigned int modelLoc = glGetUniformLocation(Shader::shaderProgram, name);
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(matrix));
+    glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void Shader::SetUniform(const char* name, float value) {
-    unsigned int modelLoc = glGetUniformLocation(Shader::shaderProgram, name);
-    glUniform1f(modelLoc, value);
+    glUniform1f(GetUniformLocation(name), value);
 }
 
 void Shader::SetUniform(const char* name, glm::vec2 value) {
-    unsigned int modelLoc = glGetUniformLocation(Shader::shaderProgram, name);
-    glUniform2fv(modelLoc, 1, glm::value_ptr(value));
+    glUniform2fv(GetUniformLocation(name), 1, glm::value_ptr(value));
+}
+
+GLint Shader::GetUniformLocation(const char* name) const {
+    auto location = uniformLocations.find(name);
+    return location != uniformLocations.end() ? location->second : -1;
 }
 
 void Shader::ReloadShader() {
@@ -63,15 +66,48 @@ void Shader::ReloadShader() {
     else {
         Shader::shaderProgram = CreateDefaultShader();
     }
+    OnLinked();
+}
+
+void Shader::OnLinked() {
+    uniformLocations.clear();
+    if (!shaderProgram)
+        return;
+
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::string name(maxNameLength, '\0');
+    for (GLint i = 0; i < uniformCount; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(shaderProgram, (GLuint)i, maxNameLength, &length, &size, &type, &name[0]);
+
+        // Block members are active uniforms too but have no location
+        std::string uniformName = name.substr(0, length);
+        GLint location = glGetUniformLocation(shaderProgram, uniformName.c_str());
+        if (location < 0)
+            continue;
+
+        // Arrays are reported as "name[0]", keep the plain name as well
+        uniformLocations[uniformName] = location;
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+    }
+
+    GLuint cameraBlock = glGetUniformBlockIndex(shaderProgram, "Camera");
+    if (cameraBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(shaderProgram, cameraBlock, CAMERA_BLOCK_BINDING);
 }
 
 GLuint CreateDefaultShader() {
     const char* vertexSource =
         "#version 330 core\n"
         "layout (location = 0) in vec3 aPos;"
+        "layout (std140) uniform Camera { mat4 view; mat4 projection; };"
         "uniform mat4 model;"
-        "uniform mat4 view;"
-        "uniform mat4 projection;"
         "void main()"
         "{"
         "   gl_Position = projection * view * model * vec4(aPos, 1.0f);"
@@ -1,9 +1,14 @@
 #pragma once
+#include <string>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 class Shader
 {
 public:
+	// Binding point of the Camera uniform block, see CameraUniforms
+	static const GLuint CAMERA_BLOCK_BINDING = 0;
+
 	Shader(const char* vertexPath, const char* fragmentPath);
 	//Shader(const unsigned char* vertexSource, int vertexSize, const unsigned char* fragmentSource, int fragmentSize);
 	~Shader();
@@ -12,8 +17,13 @@ public:
 	void SetUniform(const char* name, float value);
 	void SetUniform(const char* name, glm::vec2 value);
 	void ReloadShader();
+	// -1 for uniforms the program doesn't have, which glUniform* ignores
+	GLint GetUniformLocation(const char* name) const;
 private:
 	GLuint shaderProgram;
 	const char *vertexPath, *fragmentPath;
-};
+	// Filled in after every link so setting a uniform never asks the driver
+	std::unordered_map<std::string, GLint> uniformLocations;
 
+	void OnLinked();
+};
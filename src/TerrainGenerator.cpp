@@ -1,6 +1,22 @@
 #include "TerrainGenerator.h"
 
+// The batched path relies on the same rounding as the scalar one. GCC and Clang get
+// -ffp-contract=off from CMakeLists.txt, MSVC needs the pragma
+#ifdef _MSC_VER
+#pragma fp_contract(off)
+#endif
+
 #include <math.h>
+#include <float.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TERRAIN_AVX2_KERNEL
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 typedef struct {
     float x, y;
@@ -103,4 +119,220 @@ float TerrainGenerator::GetHeight(int x, int z) {
     float height = val * AMPLITUDE;
 
 	return height;
+}
+
+// Columns are processed in groups of this many lanes, one AVX2 register of floats
+static const int LANES = 8;
+
+// Gradients at the four lattice corners around each lane, plus the offsets into the cell
+struct PerlinLanes {
+    float g00x[LANES], g00y[LANES];
+    float g10x[LANES], g10y[LANES];
+    float g01x[LANES], g01y[LANES];
+    float g11x[LANES], g11y[LANES];
+    float x[LANES];   // Sample coordinate
+    float ix0[LANES]; // (float)x0
+    float ix1[LANES]; // (float)(x0 + 1)
+    float sx[LANES];
+};
+
+// Same arithmetic as perlin(), written out per lane so every rounding step matches
+static void PerlinKernelScalar(const PerlinLanes& l, int count, float y, float iy0, float iy1, float sy, float amp, float* out) {
+    for (int i = 0; i < count; i++) {
+        float dy0 = y - iy0;
+        float dy1 = y - iy1;
+        float dx0 = l.x[i] - l.ix0[i];
+        float dx1 = l.x[i] - l.ix1[i];
+
+        float n0 = (dx0 * l.g00x[i] + dy0 * l.g00y[i]);
+        float n1 = (dx1 * l.g10x[i] + dy0 * l.g10y[i]);
+        float ix0 = interpolate(n0, n1, l.sx[i]);
+
+        n0 = (dx0 * l.g01x[i] + dy1 * l.g01y[i]);
+        n1 = (dx1 * l.g11x[i] + dy1 * l.g11y[i]);
+        float ix1 = interpolate(n0, n1, l.sx[i]);
+
+        out[i] += interpolate(ix0, ix1, sy) * amp;
+    }
+}
+
+#ifdef TERRAIN_AVX2_KERNEL
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TERRAIN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TERRAIN_TARGET_AVX2
+#endif
+
+// interpolate() promotes to double, so the smoothstep is done on two halves of four doubles
+TERRAIN_TARGET_AVX2 static inline __m128 InterpolateHalf(__m128 a0, __m128 a1, __m128 w) {
+    __m256d diff = _mm256_cvtps_pd(_mm_sub_ps(a1, a0));
+    __m256d wd = _mm256_cvtps_pd(w);
+    __m256d r = _mm256_mul_pd(diff, _mm256_sub_pd(_mm256_set1_pd(3.0), _mm256_mul_pd(wd, _mm256_set1_pd(2.0))));
+    r = _mm256_mul_pd(r, wd);
+    r = _mm256_mul_pd(r, wd);
+    r = _mm256_add_pd(r, _mm256_cvtps_pd(a0));
+    return _mm256_cvtpd_ps(r);
+}
+
+TERRAIN_TARGET_AVX2 static inline __m256 Interpolate8(__m256 a0, __m256 a1, __m256 w) {
+    __m128 lo = InterpolateHalf(_mm256_castps256_ps128(a0), _mm256_castps256_ps128(a1), _mm256_castps256_ps128(w));
+    __m128 hi = InterpolateHalf(_mm256_extractf128_ps(a0, 1), _mm256_extractf128_ps(a1, 1), _mm256_extractf128_ps(w, 1));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+// Separate multiplies and adds on purpose, a fused multiply-add would round differently than perlin()
+TERRAIN_TARGET_AVX2 static void PerlinKernelAvx2(const PerlinLanes& l, float y, float iy0, float iy1, float sy, float amp, float* out) {
+    __m256 x = _mm256_loadu_ps(l.x);
+    __m256 dy0 = _mm256_set1_ps(y - iy0);
+    __m256 dy1 = _mm256_set1_ps(y - iy1);
+    __m256 dx0 = _mm256_sub_ps(x, _mm256_loadu_ps(l.ix0));
+    __m256 dx1 = _mm256_sub_ps(x, _mm256_loadu_ps(l.ix1));
+    __m256 sx = _mm256_loadu_ps(l.sx);
+
+    __m256 n0 = _mm256_add_ps(_mm256_mul_ps(dx0, _mm256_loadu_ps(l.g00x)), _mm256_mul_ps(dy0, _mm256_loadu_ps(l.g00y)));
+    __m256 n1 = _mm256_add_ps(_mm256_mul_ps(dx1, _mm256_loadu_ps(l.g10x)), _mm256_mul_ps(dy0, _mm256_loadu_ps(l.g10y)));
+    __m256 ix0 = Interpolate8(n0, n1, sx);
+
+    n0 = _mm256_add_ps(_mm256_mul_ps(dx0, _mm256_loadu_ps(l.g01x)), _mm256_mul_ps(dy1, _mm256_loadu_ps(l.g01y)));
+    n1 = _mm256_add_ps(_mm256_mul_ps(dx1, _mm256_loadu_ps(l.g11x)), _mm256_mul_ps(dy1, _mm256_loadu_ps(l.g11y)));
+    __m256 ix1 = Interpolate8(n0, n1, sx);
+
+    __m256 value = Interpolate8(ix0, ix1, _mm256_set1_ps(sy));
+    _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(out), _mm256_mul_ps(value, _mm256_set1_ps(amp))));
+}
+
+#endif
+
+bool TerrainGenerator::HasAvx2() {
+#if defined(TERRAIN_AVX2_KERNEL) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(TERRAIN_AVX2_KERNEL)
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+TerrainGenerator::TerrainGenerator() : useSimd(HasAvx2()) {}
+
+void TerrainGenerator::GetHeights(int x0, int z0, int width, int depth, float* out, int step) {
+    int count = width * depth;
+    for (int i = 0; i < count; i++) {
+        out[i] = 0.0f;
+    }
+
+    float freq = 1;
+    float amp = 1;
+    float ampAcc = 0;
+
+    std::vector<vector2> lattice;
+    PerlinLanes lanes;
+
+    for (int octave = 0; octave < OCTAVES; octave++)
+    {
+        // Neighbouring columns mostly share lattice corners, so gradients (and their sin/cos)
+        // are evaluated once per corner. When the columns are too sparse for that to pay off
+        // they are evaluated per column like perlin() does.
+        int latticeX0 = (int)(x0 * freq / SIZE);
+        int latticeZ0 = (int)(z0 * freq / SIZE);
+        int latticeWidth = (int)((x0 + (width - 1) * step) * freq / SIZE) - latticeX0 + 2;
+        int latticeDepth = (int)((z0 + (depth - 1) * step) * freq / SIZE) - latticeZ0 + 2;
+        bool useLattice = (long long)latticeWidth * latticeDepth <= 4ll * count;
+
+        if (useLattice) {
+            lattice.resize(latticeWidth * latticeDepth);
+            for (int lz = 0; lz < latticeDepth; lz++) {
+                for (int lx = 0; lx < latticeWidth; lx++) {
+                    lattice[lz * latticeWidth + lx] = randomGradient(latticeX0 + lx, latticeZ0 + lz);
+                }
+            }
+        }
+
+        for (int row = 0; row < depth; row++) {
+            int z = z0 + row * step;
+            float y = z * freq / SIZE;
+            int iy0 = (int)y;
+            int iy1 = iy0 + 1;
+            float sy = y - (float)iy0;
+
+            for (int column = 0; column < width; column += LANES) {
+                int laneCount = width - column < LANES ? width - column : LANES;
+
+                for (int i = 0; i < laneCount; i++) {
+                    int x = x0 + (column + i) * step;
+                    float fx = x * freq / SIZE;
+                    int ix0 = (int)fx;
+                    int ix1 = ix0 + 1;
+
+                    vector2 g00, g10, g01, g11;
+                    if (useLattice) {
+                        const vector2* row0 = &lattice[(iy0 - latticeZ0) * latticeWidth + (ix0 - latticeX0)];
+                        const vector2* row1 = row0 + latticeWidth;
+                        g00 = row0[0];
+                        g10 = row0[1];
+                        g01 = row1[0];
+                        g11 = row1[1];
+                    }
+                    else {
+                        g00 = randomGradient(ix0, iy0);
+                        g10 = randomGradient(ix1, iy0);
+                        g01 = randomGradient(ix0, iy1);
+                        g11 = randomGradient(ix1, iy1);
+                    }
+
+                    lanes.g00x[i] = g00.x; lanes.g00y[i] = g00.y;
+                    lanes.g10x[i] = g10.x; lanes.g10y[i] = g10.y;
+                    lanes.g01x[i] = g01.x; lanes.g01y[i] = g01.y;
+                    lanes.g11x[i] = g11.x; lanes.g11y[i] = g11.y;
+                    lanes.x[i] = fx;
+                    lanes.ix0[i] = (float)ix0;
+                    lanes.ix1[i] = (float)ix1;
+                    lanes.sx[i] = fx - (float)ix0;
+                }
+
+                float* rowOut = out + row * width + column;
+#ifdef TERRAIN_AVX2_KERNEL
+                if (useSimd && laneCount == LANES) {
+                    PerlinKernelAvx2(lanes, y, (float)iy0, (float)iy1, sy, amp, rowOut);
+                    continue;
+                }
+#endif
+                PerlinKernelScalar(lanes, laneCount, y, (float)iy0, (float)iy1, sy, amp, rowOut);
+            }
+        }
+
+        ampAcc += amp;
+
+        freq *= 2;
+        amp /= 2;
+    }
+
+    for (int i = 0; i < count; i++) {
+        float val = out[i];
+        val /= ampAcc;
+        out[i] = val * AMPLITUDE;
+    }
+}
+
+HeightRange TerrainGenerator::GetHeightRange(int x0, int z0, int width, int depth) {
+    HeightRange range = { FLT_MAX, -FLT_MAX };
+
+    std::vector<float> heights(width * depth);
+    GetHeights(x0, z0, width, depth, heights.data());
+
+    for (float height : heights) {
+        if (height < range.minHeight) range.minHeight = height;
+        if (height > range.maxHeight) range.maxHeight = height;
+    }
+
+    return range;
 }
\ No newline at end of file
@@ -1,11 +1,29 @@
 #pragma once
 
+struct HeightRange {
+	float minHeight;
+	float maxHeight;
+};
+
 class TerrainGenerator {
 public:
+	TerrainGenerator();
+
 	float GetHeight(int x, int z);
+	// Heights for a width x depth grid of columns starting at x0, z0, spaced step blocks apart.
+	// Written row by row to out[(z - z0) / step * width + (x - x0) / step]. Gives exactly the
+	// same values as calling GetHeight on every column.
+	void GetHeights(int x0, int z0, int width, int depth, float* out, int step = 1);
+	// Lowest and highest height over a width x depth grid of columns starting at x0, z0
+	HeightRange GetHeightRange(int x0, int z0, int width, int depth);
+
+	static bool HasAvx2();
+	void SetUseSimd(bool value) { useSimd = value && HasAvx2(); }
+	bool IsUsingSimd() const { return useSimd; }
 private:
 	const int OCTAVES = 8;
 	const float SIZE = 120.0f;
 	const float AMPLITUDE = 20.0f;
-};
 
+	bool useSimd;
+};
@@ -0,0 +1,234 @@
+#include "VertexArena.h"
+
+#include <algorithm>
+
+static uint32_t RoundUp(uint32_t value, uint32_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+VertexArena::~VertexArena() {
+    for (Page& page : pages) {
+        if (page.vbo != 0)
+            ReleasePage(page);
+    }
+    if (initialized) {
+        glDeleteBuffers(1, &offsetBuffer);
+        glDeleteBuffers(1, &commandBuffer);
+    }
+}
+
+void VertexArena::Initialize() {
+    // Base instances are what point each draw at its chunk offset, so indirect
+    // draws are only used if they come together
+#ifdef GL_VERSION_4_3
+    useIndirect = GLAD_GL_VERSION_4_3 != 0;
+#endif
+
+    glGenBuffers(1, &offsetBuffer);
+    if (useIndirect)
+        glGenBuffers(1, &commandBuffer);
+    initialized = true;
+}
+
+bool VertexArena::Upload(Allocation& allocation, const uint32_t* vertices, uint32_t vertexCount) {
+    if (vertexCount == 0) {
+        Free(allocation);
+        return true;
+    }
+
+    // Kept in place unless it has to grow or is now mostly unused
+    if (!allocation.IsValid() || vertexCount > allocation.capacity || vertexCount < allocation.capacity / 4) {
+        Free(allocation);
+        if (!Allocate(vertexCount, allocation))
+            return false;
+    }
+
+    const Page& page = pages[allocation.page];
+    glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)allocation.first * VERTEX_SIZE, (GLsizeiptr)vertexCount * VERTEX_SIZE, vertices);
+    return true;
+}
+
+void VertexArena::Free(Allocation& allocation) {
+    if (!allocation.IsValid())
+        return;
+
+    Page& page = pages[allocation.page];
+    page.allocator.Free(allocation.first);
+    page.owners.erase(allocation.first);
+    allocatedVertices -= allocation.capacity;
+
+    allocation = Allocation();
+}
+
+bool VertexArena::Allocate(uint32_t vertexCount, Allocation& allocation) {
+    if (!initialized)
+        Initialize();
+
+    uint32_t length = RoundUp(vertexCount, ALLOCATION_GRANULARITY);
+
+    // Earlier pages first, so later ones drain and can be released
+    int pageIndex = -1;
+    uint32_t first = BufferAllocator::INVALID_OFFSET;
+    for (size_t i = 0; i < pages.size() && first == BufferAllocator::INVALID_OFFSET; i++) {
+        first = pages[i].allocator.Allocate(length);
+        pageIndex = (int)i;
+    }
+
+    if (first == BufferAllocator::INVALID_OFFSET) {
+        pageIndex = CreatePage(std::max(PAGE_VERTICES, length));
+        first = pages[pageIndex].allocator.Allocate(length);
+        if (first == BufferAllocator::INVALID_OFFSET)
+            return false;
+    }
+
+    allocation.page = pageIndex;
+    allocation.first = first;
+    allocation.capacity = length;
+    pages[pageIndex].owners[first] = &allocation;
+    allocatedVertices += length;
+    return true;
+}
+
+int VertexArena::CreatePage(uint32_t capacity) {
+    // Slots of released pages are reused so page indices stay small
+    size_t index = 0;
+    while (index < pages.size() && pages[index].vbo != 0)
+        index++;
+    if (index == pages.size())
+        pages.emplace_back();
+
+    Page& page = pages[index];
+    page.allocator.Reset(capacity);
+
+    glGenVertexArrays(1, &page.vao);
+    glGenBuffers(1, &page.vbo);
+    glBindVertexArray(page.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * VERTEX_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, VERTEX_SIZE, (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Chunk offsets come one per instance, the fallback sets attribute 2 per draw instead
+    if (useIndirect) {
+        glBindBuffer(GL_ARRAY_BUFFER, offsetBuffer);
+        glVertexAttribIPointer(2, 3, GL_INT, sizeof(ChunkDrawList::Offset), (void*)0);
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(2);
+    }
+
+    glBindVertexArray(0);
+    return (int)index;
+}
+
+void VertexArena::ReleasePage(Page& page) {
+    glDeleteVertexArrays(1, &page.vao);
+    glDeleteBuffers(1, &page.vbo);
+    page.vao = 0;
+    page.vbo = 0;
+    page.allocator.Reset(0);
+    page.owners.clear();
+}
+
+void VertexArena::Defragment() {
+    uint32_t budget = DEFRAGMENT_VERTICES_PER_FRAME;
+
+    for (size_t i = 0; i < pages.size(); i++) {
+        Page& page = pages[i];
+        if (page.vbo == 0)
+            continue;
+
+        // The first page is kept so a world that empties out doesn't churn buffers
+        if (page.allocator.IsEmpty()) {
+            if (i > 0)
+                ReleasePage(page);
+            continue;
+        }
+
+        if (budget == 0 || page.allocator.GetStats().fragmentation < DEFRAGMENT_THRESHOLD)
+            continue;
+
+        auto moves = page.allocator.Defragment(budget);
+        if (moves.empty())
+            continue;
+
+        // Copies within one buffer are fine as long as the ranges don't overlap
+        glBindBuffer(GL_COPY_READ_BUFFER, page.vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, page.vbo);
+        for (const auto& move : moves) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)move.from * VERTEX_SIZE,
+                (GLintptr)move.to * VERTEX_SIZE, (GLsizeiptr)move.size * VERTEX_SIZE);
+
+            auto owner = page.owners.find(move.from);
+            Allocation* allocation = owner->second;
+            page.owners.erase(owner);
+            allocation->first = move.to;
+            page.owners[move.to] = allocation;
+
+            budget -= std::min(budget, move.size);
+            movedVertices += move.size;
+        }
+    }
+}
+
+void VertexArena::Draw(const ChunkDrawList& drawList) {
+    if (drawList.Size() == 0 || pages.empty())
+        return;
+
+    const auto& commands = drawList.GetCommands();
+    const auto& offsets = drawList.GetOffsets();
+
+#ifdef GL_VERSION_4_3
+    if (useIndirect) {
+        // Orphaned every frame so the driver never waits on last frame's draws
+        glBindBuffer(GL_ARRAY_BUFFER, offsetBuffer);
+        glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(ChunkDrawList::Offset), offsets.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(ChunkDrawList::DrawCommand), commands.data(), GL_STREAM_DRAW);
+
+        for (const auto& batch : drawList.GetBatches()) {
+            glBindVertexArray(pages[batch.page].vao);
+            glMultiDrawArraysIndirect(GL_TRIANGLES, (const void*)(batch.firstCommand * sizeof(ChunkDrawList::DrawCommand)),
+                (GLsizei)batch.commandCount, 0);
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+        return;
+    }
+#endif
+
+    for (const auto& batch : drawList.GetBatches()) {
+        glBindVertexArray(pages[batch.page].vao);
+        for (size_t i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++) {
+            const auto& offset = offsets[commands[i].baseInstance];
+            glVertexAttribI3i(2, offset.x, offset.y, offset.z);
+            glDrawArrays(GL_TRIANGLES, (GLint)commands[i].first, (GLsizei)commands[i].count);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+size_t VertexArena::GetPageCount() const {
+    size_t count = 0;
+    for (const Page& page : pages)
+        count += page.vbo != 0;
+    return count;
+}
+
+size_t VertexArena::GetReservedBytes() const {
+    size_t bytes = 0;
+    for (const Page& page : pages)
+        bytes += (size_t)page.allocator.GetCapacity() * VERTEX_SIZE;
+    return bytes;
+}
+
+float VertexArena::GetFragmentation() const {
+    float fragmentation = 0.0f;
+    for (const Page& page : pages) {
+        if (page.vbo != 0)
+            fragmentation = std::max(fragmentation, page.allocator.GetStats().fragmentation);
+    }
+    return fragmentation;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+#include "BufferAllocator.h"
+#include "ChunkDrawList.h"
+
+// Chunk meshes sub-allocated from a few large vertex buffers. Each page is one
+// buffer with its own vertex array, so a frame binds each page once and draws all
+// of its chunks with a single glMultiDrawArraysIndirect. Without GL 4.3 the draws
+// fall back to one glDrawArrays per chunk, still without any buffer rebinds.
+//
+// Ranges within a page come from a BufferAllocator. Fragmented pages are compacted
+// a little every frame by copying meshes on the GPU, and pages left empty are
+// given back to the driver.
+//
+// Everything here has to be called on the render thread.
+class VertexArena
+{
+public:
+    // One packed uint32 per vertex, see VertexData::Pack
+    static constexpr uint32_t VERTEX_SIZE = sizeof(uint32_t);
+    static constexpr uint32_t VERTEX_WORDS = VERTEX_SIZE / sizeof(uint32_t);
+    static constexpr uint32_t PAGE_VERTICES = 1u << 23; // 32 MB pages
+    // Allocations are rounded up so freed ranges are easier to reuse
+    static constexpr uint32_t ALLOCATION_GRANULARITY = 64;
+    // Pages with more of their free space split up than this get compacted
+    static constexpr float DEFRAGMENT_THRESHOLD = 0.5f;
+    static constexpr uint32_t DEFRAGMENT_VERTICES_PER_FRAME = 1u << 19; // 2 MB of copies
+
+    struct Allocation {
+        int page = -1;
+        uint32_t first = 0;    // In vertices
+        uint32_t capacity = 0; // In vertices
+
+        bool IsValid() const { return page >= 0; }
+    };
+
+    VertexArena() = default;
+    ~VertexArena();
+    VertexArena(const VertexArena&) = delete;
+    VertexArena& operator=(const VertexArena&) = delete;
+
+    // Writes the vertices into the allocation, moving it if they don't fit. The
+    // allocation must stay at the same address until it's freed, compaction
+    // updates it in place.
+    bool Upload(Allocation& allocation, const uint32_t* vertices, uint32_t vertexCount);
+    void Free(Allocation& allocation);
+
+    // Compacts fragmented pages and releases empty ones, call before building a draw list
+    void Defragment();
+
+    void Draw(const ChunkDrawList& drawList);
+
+    bool UsesIndirectDraws() const { return useIndirect; }
+    size_t GetPageCount() const;
+    size_t GetReservedBytes() const;
+    size_t GetAllocatedBytes() const { return (size_t)allocatedVertices * VERTEX_SIZE; }
+    size_t GetMovedBytes() const { return (size_t)movedVertices * VERTEX_SIZE; }
+    // The most fragmented page's share of free space outside its largest free range
+    float GetFragmentation() const;
+
+private:
+    struct Page {
+        GLuint vao = 0, vbo = 0; // Both 0 once the page is released
+        BufferAllocator allocator;
+        std::unordered_map<uint32_t, Allocation*> owners; // By first vertex
+    };
+
+    bool initialized = false;
+    bool useIndirect = false;
+    GLuint offsetBuffer = 0;
+    GLuint commandBuffer = 0;
+    std::vector<Page> pages;
+    uint64_t allocatedVertices = 0;
+    uint64_t movedVertices = 0;
+
+    void Initialize();
+    bool Allocate(uint32_t vertexCount, Allocation& allocation);
+    int CreatePage(uint32_t capacity);
+    void ReleasePage(Page& page);
+};
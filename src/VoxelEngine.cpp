@@ -18,12 +18,18 @@
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <cstring>
 
 #include "Camera.h"
 #include "Shader.h"
+#include "CameraUniforms.h"
 #include "World.h"
+#include "HeightmapGenerator.h"
+#include "DensityGenerator.h"
 #include "Block.h"
 #include "Debugging.h"
+#include "HorizonRenderer.h"
+#include "LayoutBenchmark.h"
 
 #include "AssetLoader.h"
 
@@ -37,7 +43,7 @@ const float frameWidth = 1600.0f, frameHeight = 1200.0f;
 const float frameWidth = 800.0f, frameHeight = 600.0f;
 #endif
 Camera camera = Camera();
-Shader *shaders[5];
+Shader *shaders[6];
 GLFWwindow* window;
 
 int Chunk::chunkCount = 0;
@@ -189,6 +195,60 @@ int init_glfw() {
     return 0;
 }
 
+struct TerrainBenchmark {
+    bool done = false;
+    bool identical = true;
+    double scalarColumnsPerSecond = 0.0;
+    double batchColumnsPerSecond = 0.0;
+    double simdColumnsPerSecond = 0.0;
+};
+
+// Times GetHeight against GetHeights on the 17x17 grids LoadChunk samples
+static TerrainBenchmark BenchmarkTerrain(TerrainGenerator& generator) {
+    const int gridSize = Chunk::CHUNK_SIZE + 1;
+    const int chunkCount = 256;
+    const int columns = gridSize * gridSize * chunkCount;
+
+    TerrainBenchmark result;
+    std::vector<float> reference(columns), batch(columns);
+    bool useSimd = generator.IsUsingSimd();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int c = 0; c < chunkCount; c++) {
+        for (int z = 0; z < gridSize; z++) {
+            for (int x = 0; x < gridSize; x++) {
+                reference[(c * gridSize + z) * gridSize + x] = generator.GetHeight(c * Chunk::CHUNK_SIZE + x, z);
+            }
+        }
+    }
+    std::chrono::duration<double> scalarTime = std::chrono::high_resolution_clock::now() - start;
+    result.scalarColumnsPerSecond = columns / scalarTime.count();
+
+    for (int simd = 0; simd < 2; simd++) {
+        generator.SetUseSimd(simd == 1);
+        if (simd == 1 && !generator.IsUsingSimd())
+            break;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int c = 0; c < chunkCount; c++) {
+            generator.GetHeights(c * Chunk::CHUNK_SIZE, 0, gridSize, gridSize, &batch[c * gridSize * gridSize]);
+        }
+        std::chrono::duration<double> batchTime = std::chrono::high_resolution_clock::now() - start;
+        (simd == 1 ? result.simdColumnsPerSecond : result.batchColumnsPerSecond) = columns / batchTime.count();
+
+        result.identical &= memcmp(reference.data(), batch.data(), columns * sizeof(float)) == 0;
+    }
+
+    generator.SetUseSimd(useSimd);
+    result.done = true;
+
+    std::cout << "Terrain: GetHeight " << (int)result.scalarColumnsPerSecond << " columns/s, GetHeights "
+        << (int)result.batchColumnsPerSecond << " columns/s, AVX2 " << (int)result.simdColumnsPerSecond << " columns/s"
+        << (result.identical ? "" : " (MISMATCH)") << std::endl;
+
+    return result;
+}
+
 static bool TraceRay(World& world, glm::vec3 p, glm::vec3 dir, float max_d, glm::ivec3& hit_pos, glm::vec3& hit_norm, std::vector<glm::ivec3>* rayBlocks = nullptr) {
 
     // consider raycast vector to be parametrized by t
@@ -290,7 +350,7 @@ static bool TraceRay(World& world, glm::vec3 p, glm::vec3 dir, float max_d, glm:
 
 bool closeWindow = false;
 
-int main()
+int main(int argc, char** argv)
 {
     if (init_glfw()) {
         return -1;
@@ -301,12 +361,16 @@ int main()
     Shader skyboxShader = Shader("Resources/Shaders/skybox.vert", "Resources/Shaders/skybox.frag");
     Shader screenShader = Shader("Resources/Shaders/screen.vert", "Resources/Shaders/screen.frag");
     Shader holeShader = Shader("Resources/Shaders/hole.vert", "Resources/Shaders/hole.frag");
+    Shader horizonShader = Shader("Resources/Shaders/horizon.vert", "Resources/Shaders/horizon.frag");
 
     shaders[0] = &s;
     shaders[1] = &debugShader;
     shaders[2] = &skyboxShader;
     shaders[3] = &screenShader;
     shaders[4] = &holeShader;
+    shaders[5] = &horizonShader;
+
+    CameraUniforms cameraUniforms;
 
     GLuint texture = AssetLoader::loadTexture("Resources/Textures/atlas.png");
 
@@ -327,12 +391,38 @@ int main()
     glFrontFace(GL_CW);
 
     TerrainGenerator generator;
+    HeightmapGenerator heightmapGenerator(&generator);
+    DensityGenerator densityGenerator(&generator);
+
+    // Pass --density for 3D terrain with overhangs and caves
+    bool useDensity = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--density") == 0)
+            useDensity = true;
+    }
 
-    World world = World(&generator);
+    // Each generator gets its own save so their chunks are never mixed
+    std::string saveDirectory = useDensity ? "Saves/density" : "Saves/heightmap";
+    // and neither are chunks of another size, 16 keeps the original directories
+    if (Chunk::CHUNK_SIZE != 16)
+        saveDirectory += "-" + std::to_string(Chunk::CHUNK_SIZE);
+    WorldStorage worldStorage(saveDirectory);
+
+    // Baked from the debug window, the spawn area then loads without generating or meshing
+    std::string snapshotPath = saveDirectory + "/spawn.snapshot";
+    WorldSnapshot worldSnapshot;
+    if (worldSnapshot.Open(snapshotPath))
+        std::cout << "Mapped " << worldSnapshot.GetChunkCount() << " chunks from " << snapshotPath << std::endl;
+
+    World world = World(useDensity ? static_cast<WorldGenerator*>(&densityGenerator) : &heightmapGenerator, &worldStorage,
+        worldSnapshot.IsOpen() ? &worldSnapshot : nullptr);
 
 	std::thread worldThread(&World::WorldThread, &world);
+	std::thread saveThread(&World::SaveThread, &world);
 
     Debugging debugging = Debugging();
+    HorizonRenderer horizon(&generator);
+    bool showHorizon = true;
 
     #pragma region SKYBOX SETUP
 
@@ -484,6 +574,8 @@ int main()
     glEnableVertexAttribArray(1);
 
     bool vsync = true;
+    TerrainBenchmark terrainBenchmark;
+    BlockLayoutBenchmark blockLayoutBenchmark;
 
     //bool mousePressed = false;
     std::map<int, bool> buttonsPressed;
@@ -602,6 +694,7 @@ int main()
         
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = camera.GetProjectionMatrix(frameWidth, frameHeight);
+        cameraUniforms.Update(view, projection);
 
         glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
         glViewport(0, 0, frameWidth, frameHeight);
@@ -612,24 +705,37 @@ int main()
 
         glEnable(GL_DEPTH_TEST);
 
+        // The horizon has its own far plane, so it gets the back half of the depth
+        // range and the chunks the front half. The skybox still only fills depth 1.
+        if (showHorizon) {
+            horizon.Update(camera.GetPosition());
+
+            glm::ivec3 cameraChunk = glm::ivec3(glm::floor(camera.GetPosition() / (float)Chunk::CHUNK_SIZE));
+            glm::vec2 holeCenter = glm::vec2(cameraChunk.x + 0.5f, cameraChunk.z + 0.5f) * (float)Chunk::CHUNK_SIZE;
+            float holeHalfExtent = (world.GetEffectiveRenderDistance() + 0.5f) * Chunk::CHUNK_SIZE;
+
+            glDisable(GL_CULL_FACE);
+            glDepthRange(0.5, 1.0);
+            horizon.Render(horizonShader, camera.GetProjectionMatrix(frameWidth, frameHeight, 1.0f, horizon.GetViewDistance() * 2.0f),
+                holeCenter, holeHalfExtent, world.IsSphericalRenderDistance());
+        }
+        glDepthRange(0.0, 0.5);
+
         glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
         if (wireframe) glDisable(GL_CULL_FACE); else glEnable(GL_CULL_FACE);
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture);
-        world.Render(s, view, projection, frameWidth, frameHeight, currentFrame);
+        world.Render(s, frameWidth, frameHeight, currentFrame);
 
         glEnable(GL_CULL_FACE);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-        glm::mat4 skyboxView = glm::mat4(glm::mat3(view));
-
+        glDepthRange(0.0, 1.0);
         glDepthFunc(GL_LEQUAL);
         glDepthMask(GL_FALSE);
 
         skyboxShader.Use();
-        skyboxShader.SetUniform("view", skyboxView);
-        skyboxShader.SetUniform("projection", projection);
 
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
@@ -639,7 +745,7 @@ int main()
         glm::ivec3 pos;
         glm::vec3 norm;
         if (TraceRay(world, camera.GetPosition(), camera.GetDirection(), 50, pos, norm)) {
-            debugging.DrawCube(debugShader, view, projection, pos);
+            debugging.DrawCube(debugShader, pos);
         }
 
         glDepthMask(GL_TRUE);
@@ -659,8 +765,6 @@ int main()
         glm::mat4 model = glm::mat4(1);
         model = glm::translate(model, glm::vec3(0, 2, 0));
         holeShader.SetUniform("model", model);
-        holeShader.SetUniform("view", view);
-        holeShader.SetUniform("projection", projection);
         holeShader.SetUniform("time", currentFrame);
         holeShader.SetUniform("uResolution", glm::vec2(frameWidth, frameHeight));
 
@@ -688,6 +792,91 @@ int main()
                 ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", frameTime, fps);
                 ImGui::PlotLines("Frame Time (ms)", frameTimes, 100, i);
                 ImGui::Text("Chunk count: %d", Chunk::chunkCount);
+
+                int renderDistance = world.GetRenderDistance();
+                int verticalRenderDistance = world.GetVerticalRenderDistance();
+                bool sphericalRenderDistance = world.IsSphericalRenderDistance();
+                int memoryBudgetMB = (int)(world.GetMemoryBudget() >> 20);
+
+                if (ImGui::SliderInt("Render distance", &renderDistance, World::MIN_RENDER_DISTANCE, World::MAX_RENDER_DISTANCE) |
+                    ImGui::SliderInt("Vertical distance", &verticalRenderDistance, World::MIN_RENDER_DISTANCE, World::MAX_RENDER_DISTANCE)) {
+                    world.SetRenderDistance(renderDistance, verticalRenderDistance);
+                }
+                if (ImGui::Checkbox("Spherical", &sphericalRenderDistance)) {
+                    world.SetSphericalRenderDistance(sphericalRenderDistance);
+                }
+                if (ImGui::SliderInt("Memory budget (MB)", &memoryBudgetMB, 64, 8192)) {
+                    world.SetMemoryBudget((size_t)memoryBudgetMB << 20);
+                }
+                ImGui::Text("Effective distance %d x %d", world.GetEffectiveRenderDistance(), world.GetEffectiveVerticalRenderDistance());
+                ImGui::Checkbox("Horizon", &showHorizon);
+                ImGui::Text("Horizon %.1f km, %.0f KB, %llu heights sampled", horizon.GetViewDistance() / 1000.0f,
+                    horizon.GetMemoryUsage() / 1024.0, (unsigned long long)horizon.GetSampleCount());
+
+                int lod1Distance = world.GetLodDistance(1);
+                int lod2Distance = world.GetLodDistance(2);
+                if (ImGui::SliderInt("LOD 2x distance", &lod1Distance, 0, World::MAX_RENDER_DISTANCE) |
+                    ImGui::SliderInt("LOD 4x distance", &lod2Distance, 0, World::MAX_RENDER_DISTANCE)) {
+                    world.SetLodDistances(lod1Distance, lod2Distance);
+                }
+                ImGui::Text("Resident chunk memory %.1f MB", world.GetResidentBytes() / (1024.0 * 1024.0));
+                ImGui::Text("Pooled chunks: %zu", world.GetPooledChunkCount());
+                ImGui::Text("Chunk draws: %zu in %zu batches (%s)", world.GetDrawCount(), world.GetDrawBatchCount(),
+                    world.GetVertexArena().UsesIndirectDraws() ? "indirect" : "per chunk");
+                ImGui::Text("Chunk vertices: %u drawn, %u facing away", world.GetDrawList().GetVertexCount(),
+                    world.GetDrawList().GetCulledVertexCount());
+                MeshCache::Stats meshCacheStats = world.GetMeshCache().GetStats();
+                uint64_t meshLookups = meshCacheStats.hits + meshCacheStats.misses;
+                ImGui::Text("Mesh cache: %llu hits, %llu misses (%.0f%%), %zu meshes in %.1f / %.0f MB",
+                    (unsigned long long)meshCacheStats.hits, (unsigned long long)meshCacheStats.misses,
+                    meshLookups > 0 ? 100.0 * meshCacheStats.hits / meshLookups : 0.0, meshCacheStats.entryCount,
+                    meshCacheStats.bytes / (1024.0 * 1024.0), meshCacheStats.capacity / (1024.0 * 1024.0));
+                ImGui::Text("Vertex arena %.1f / %.1f MB in %zu pages", world.GetVertexArena().GetAllocatedBytes() / (1024.0 * 1024.0),
+                    world.GetVertexArena().GetReservedBytes() / (1024.0 * 1024.0), world.GetVertexArena().GetPageCount());
+                ImGui::Text("Arena fragmentation %.0f%%, %.1f MB compacted", world.GetVertexArena().GetFragmentation() * 100.0f,
+                    world.GetVertexArena().GetMovedBytes() / (1024.0 * 1024.0));
+
+                ChunkIO::Stats ioStats;
+                if (world.GetChunkIOStats(ioStats)) {
+                    ImGui::Text("Chunk I/O queue: %zu reads, %zu writes", ioStats.queuedReads, ioStats.queuedWrites);
+                    ImGui::Text("Chunk I/O read %.1f KB/s, write %.1f KB/s", ioStats.readBytesPerSecond / 1024.0, ioStats.writeBytesPerSecond / 1024.0);
+                    ImGui::Text("Prefetch hit rate %.1f%%", ioStats.loads > 0 ? 100.0 * ioStats.prefetchHits / ioStats.loads : 0.0);
+                }
+
+                // Delete the file to bake a new one, the mapped one can't be replaced while in use
+                if (worldSnapshot.IsOpen()) {
+                    ImGui::Text("Snapshot: %zu chunks, %.1f MB mapped", worldSnapshot.GetChunkCount(), worldSnapshot.GetMappedBytes() / (1024.0 * 1024.0));
+                }
+                else if (ImGui::Button("Bake spawn snapshot")) {
+                    world.RequestSnapshotBake(snapshotPath);
+                }
+                if (!worldSnapshot.IsOpen() && world.GetLastSnapshotBakeCount() >= 0) {
+                    ImGui::SameLine();
+                    ImGui::Text("%d chunks baked, used from the next start", world.GetLastSnapshotBakeCount());
+                }
+
+                if (ImGui::Button("Benchmark terrain")) {
+                    terrainBenchmark = BenchmarkTerrain(generator);
+                }
+                if (terrainBenchmark.done) {
+                    ImGui::Text("GetHeight %.0f columns/s", terrainBenchmark.scalarColumnsPerSecond);
+                    ImGui::Text("GetHeights %.0f columns/s, AVX2 %.0f columns/s", terrainBenchmark.batchColumnsPerSecond, terrainBenchmark.simdColumnsPerSecond);
+                    ImGui::Text(terrainBenchmark.identical ? "Heights identical" : "Heights DIFFER");
+                }
+                if (ImGui::Button("Benchmark block layouts")) {
+                    WorldGenerator* worldGenerator = useDensity ? static_cast<WorldGenerator*>(&densityGenerator) : &heightmapGenerator;
+                    int surfaceChunkY = ChunkDimensions::ToChunk((int)generator.GetHeight(0, 0));
+                    blockLayoutBenchmark = BenchmarkBlockLayouts(*worldGenerator, surfaceChunkY);
+                }
+                if (blockLayoutBenchmark.done) {
+                    ImGui::Text("Mesher pass ns/block: linear %.2f, brick %.2f, Morton %.2f", blockLayoutBenchmark.nanosecondsPerBlock[0],
+                        blockLayoutBenchmark.nanosecondsPerBlock[1], blockLayoutBenchmark.nanosecondsPerBlock[2]);
+                    ImGui::Text("Simulated L1 misses/block: linear %.3f, brick %.3f, Morton %.3f", blockLayoutBenchmark.l1MissesPerBlock[0],
+                        blockLayoutBenchmark.l1MissesPerBlock[1], blockLayoutBenchmark.l1MissesPerBlock[2]);
+                    ImGui::Text("Simulated L2 misses/block: linear %.3f, brick %.3f, Morton %.3f", blockLayoutBenchmark.l2MissesPerBlock[0],
+                        blockLayoutBenchmark.l2MissesPerBlock[1], blockLayoutBenchmark.l2MissesPerBlock[2]);
+                    ImGui::Text(blockLayoutBenchmark.identical ? "Faces identical" : "Faces DIFFER");
+                }
                 ImGui::Image(textureColorbuffer, ImVec2(frameWidth / 4, frameHeight / 4), ImVec2(0, 1), ImVec2(1, 0));
             }
 
@@ -705,6 +894,8 @@ int main()
 
 	world.Stop();
 	worldThread.join();
+	saveThread.join();
+    world.SaveModifiedChunks();
 
     closeWindow = true;
     
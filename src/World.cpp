@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -6,28 +7,35 @@
 #include "World.h"
 #include "Shader.h"
 
-inline static int rem(int a, int b) {
-    return ((a % b) + b) % b;
+static const int kNeighbourOffsets[6][3] = {
+    { 1, 0, 0 }, {-1, 0, 0 },
+    { 0, 1, 0 }, { 0,-1, 0 },
+    { 0, 0, 1 }, { 0, 0,-1 },
+};
+
+World::World(WorldGenerator* worldGenerator, WorldStorage* worldStorage, WorldSnapshot* worldSnapshot)
+    : worldGenerator(worldGenerator), worldStorage(worldStorage), worldSnapshot(worldSnapshot), running(true), m_forceVisibilityUpdate(false) {
+    if (worldStorage) {
+        ReplayJournal();
+        chunkIO = std::make_unique<ChunkIO>(worldStorage);
+    }
 }
 
-World::World(TerrainGenerator* terrainGenerator)
-    : terrainGenerator(terrainGenerator), running(true), m_forceVisibilityUpdate(false) {
+World::World(const World& other) : worldGenerator(other.worldGenerator), worldStorage(other.worldStorage), worldSnapshot(other.worldSnapshot), running(true) {
+    if (worldStorage)
+        chunkIO = std::make_unique<ChunkIO>(worldStorage);
 }
 
-World::World(const World& other) : terrainGenerator(other.terrainGenerator), running(true) {}
-
 glm::ivec3 World::WorldToChunkCoordinates(glm::vec3 position) {
     return World::WorldToChunkCoordinates((int)position.x, (int)position.y, (int)position.z);
 }
 
 glm::ivec3 World::WorldToChunkCoordinates(int x, int y, int z) {
-    return glm::ivec3(std::floor((float)x / Chunk::CHUNK_SIZE),
-        std::floor((float)y / Chunk::CHUNK_SIZE),
-        std::floor((float)z / Chunk::CHUNK_SIZE));
+    return glm::ivec3(ChunkDimensions::ToChunk(x), ChunkDimensions::ToChunk(y), ChunkDimensions::ToChunk(z));
 }
 
 glm::ivec3 World::WorldToBlockCoordinates(int x, int y, int z) {
-    return glm::ivec3(rem(x, Chunk::CHUNK_SIZE), rem(y, Chunk::CHUNK_SIZE), rem(z, Chunk::CHUNK_SIZE));
+    return glm::ivec3(ChunkDimensions::ToLocal(x), ChunkDimensions::ToLocal(y), ChunkDimensions::ToLocal(z));
 }
 
 Chunk* World::GetChunk(int chunkX, int chunkY, int chunkZ)
@@ -71,6 +79,7 @@ void World::SetBlock(int x, int y, int z, Block block)
     if (pChunk) {
         // Immediately update the block
         pChunk->SetBlock(blockCoords.x, blockCoords.y, blockCoords.z, block);
+        JournalEdits({ BlockEdit{ x, y, z, block } });
 
         // Always rebuild the current chunk immediately on main thread
         pChunk->GenerateMesh();
@@ -161,11 +170,14 @@ void World::SetBlocksBatch(const std::vector<std::tuple<int, int, int, Block>>&
 
     // Step 1: Update all blocks WITHOUT rebuilding meshes
     std::vector<Chunk*> chunksToUpdate;
+    std::vector<BlockEdit> edits;
     for (const auto& pair : blocksByChunk) {
         auto chunkKey = pair.first;
         auto pChunk = GetChunk(std::get<0>(chunkKey), std::get<1>(chunkKey), std::get<2>(chunkKey));
 
         if (pChunk && pChunk->IsLoaded()) {
+            // Applied as one write, so nothing reading the chunk sees half a batch
+            std::vector<std::tuple<int, int, int, Block>> chunkEdits;
             for (const auto& b : pair.second) {
                 int x = std::get<0>(b);
                 int y = std::get<1>(b);
@@ -173,11 +185,14 @@ void World::SetBlocksBatch(const std::vector<std::tuple<int, int, int, Block>>&
                 Block block = std::get<3>(b);
 
                 auto blockCoords = WorldToBlockCoordinates(x, y, z);
-                pChunk->SetBlock(blockCoords.x, blockCoords.y, blockCoords.z, block);
+                chunkEdits.emplace_back(blockCoords.x, blockCoords.y, blockCoords.z, block);
+                edits.push_back(BlockEdit{ x, y, z, block });
             }
+            pChunk->SetBlocks(chunkEdits);
             chunksToUpdate.push_back(pChunk);
         }
     }
+    JournalEdits(edits);
 
     // Step 2: Update flags for chunks that had blocks changed
     for (auto* pChunk : chunksToUpdate) {
@@ -235,6 +250,7 @@ void World::ProcessPendingModifications() {
     }
 
     std::set<std::tuple<int, int, int>> chunksToRebuild;
+    std::vector<BlockEdit> edits;
 
     for (const auto& mod : mods) {
         auto chunkCoords = WorldToChunkCoordinates(mod.x, mod.y, mod.z);
@@ -243,6 +259,7 @@ void World::ProcessPendingModifications() {
 
         if (pChunk) {
             pChunk->SetBlock(blockCoords.x, blockCoords.y, blockCoords.z, mod.block);
+            edits.push_back(BlockEdit{ mod.x, mod.y, mod.z, mod.block });
             chunksToRebuild.insert(std::make_tuple(chunkCoords.x, chunkCoords.y, chunkCoords.z));
 
             // Mark adjacent chunks if on edge
@@ -255,6 +272,8 @@ void World::ProcessPendingModifications() {
         }
     }
 
+    JournalEdits(edits);
+
     // Add chunks to rebuild list
     if (!chunksToRebuild.empty()) {
         std::lock_guard<std::mutex> lock(rebuildListMutex);
@@ -295,6 +314,7 @@ void World::UpdateAdjacentChunks(int x, int y, int z) {
 
 void World::UpdateAdjacentChunks(Chunk* chunk) {
     auto coords = chunk->GetCoords();
+    bool unchangedSinceBake = chunk->IsMapped() || chunk->IsUniform();
 
     std::array<glm::ivec3, 6> chunksToRebuild{ 
         glm::ivec3(coords.x - 1, coords.y, coords.z),
@@ -309,7 +329,16 @@ void World::UpdateAdjacentChunks(Chunk* chunk) {
     {
         auto& chunkCoords = chunksToRebuild[i];
         auto pChunk = GetChunk(chunkCoords.x, chunkCoords.y, chunkCoords.z);
-        if (pChunk) {
+        if (!pChunk)
+            continue;
+
+        // A uniform chunk only shows faces where the neighbour leaves its border open,
+        // and one loading as it was baked leaves a baked mesh as it is
+        if (pChunk->IsUniform()) {
+            if (!pChunk->IsEmpty() && !IsBorderCovered(pChunk, chunk))
+                pChunk->SetNeedsRebuilding(true);
+        }
+        else if (!(pChunk->HasBakedMesh() && unchangedSinceBake)) {
             pChunk->SetNeedsRebuilding(true);
         }
     }
@@ -317,6 +346,11 @@ void World::UpdateAdjacentChunks(Chunk* chunk) {
 
 // Runs on a separate thread
 void World::WorldThread() {
+    // Each pass holds chunk pointers, between passes the thread holds none
+    int reader = chunkReclaimer.RegisterReader();
+    if (reader < 0)
+        std::cerr << "No chunk reclaimer slot left for the world thread" << std::endl;
+
     while (running) {
         {
             std::unique_lock<std::mutex> lock(workMutex);
@@ -329,19 +363,32 @@ void World::WorldThread() {
 
         if (!running) break;
 
+        EpochReclaimer::Scope readScope(chunkReclaimer, reader);
+
         ProcessPendingModifications();
         UpdateLoadList();
         UpdateSetupList();
         UpdateRebuildList();
         UpdateFlagsList();
         UpdateVisibilityList();
+
+        std::string bakePath;
+        {
+            std::lock_guard<std::mutex> lock(snapshotBakeMutex);
+            bakePath.swap(snapshotBakePath);
+        }
+        if (!bakePath.empty())
+            lastSnapshotBakeCount = BakeSnapshot(bakePath);
     }
+
+    chunkReclaimer.UnregisterReader(reader);
 }
 
 void World::Update(Camera* camera) {
     glm::vec3 cameraPosition = camera->GetPosition();
     glm::vec3 cameraView = camera->GetDirection();
 
+    m_cameraVelocity = camera->GetVelocity();
     UpdateAsyncChunker();
 
     if (m_cameraPosition != cameraPosition || m_cameraView != cameraView || m_forceVisibilityUpdate) {
@@ -351,40 +398,176 @@ void World::Update(Camera* camera) {
     m_cameraView = cameraView;
 }
 
+void World::SetRenderDistance(int horizontal, int vertical) {
+    renderDistance = std::max(MIN_RENDER_DISTANCE, std::min(horizontal, MAX_RENDER_DISTANCE));
+    verticalRenderDistance = std::max(MIN_RENDER_DISTANCE, std::min(vertical, MAX_RENDER_DISTANCE));
+
+    // Shrinking takes effect immediately, growing is left to the budget check
+    effectiveRenderDistance = std::min(effectiveRenderDistance, renderDistance);
+    effectiveVerticalRenderDistance = std::min(effectiveVerticalRenderDistance, verticalRenderDistance);
+    budgetCooldown = 0;
+}
+
+void World::SetSphericalRenderDistance(bool spherical) {
+    sphericalRenderDistance = spherical;
+    budgetCooldown = 0;
+}
+
+void World::SetMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+    budgetCooldown = 0;
+}
+
+void World::SetLodDistances(int lod1, int lod2) {
+    lodDistances[0] = std::max(0, lod1);
+    lodDistances[1] = std::max(0, lod2);
+}
+
+int World::SelectLodLevel(int dx, int dy, int dz, int currentLevel) const {
+    int distance = std::max(abs(dx), std::max(abs(dy), abs(dz)));
+
+    int level = 0;
+    for (int i = 0; i < Chunk::MAX_LOD_LEVEL; i++) {
+        if (lodDistances[i] <= 0)
+            continue;
+        // Finer levels only come back once the chunk is a ring inside the distance
+        int threshold = i < currentLevel ? lodDistances[i] - 1 : lodDistances[i];
+        if (distance >= threshold)
+            level = i + 1;
+    }
+    return level;
+}
+
+bool World::IsWithinRenderDistance(int dx, int dy, int dz, int horizontal, int vertical) const {
+    if (abs(dx) > horizontal || abs(dz) > horizontal || abs(dy) > vertical)
+        return false;
+
+    if (sphericalRenderDistance) {
+        // Ellipsoid so the vertical distance can differ from the horizontal one
+        float h = (float)(dx * dx + dz * dz) / (float)(horizontal * horizontal);
+        float v = (float)(dy * dy) / (float)(vertical * vertical);
+        return h + v <= 1.0f;
+    }
+
+    return true;
+}
+
+void World::UpdateMemoryBudget(size_t loadedBytes, size_t pooledBytes, size_t loadedCount) {
+    // Pooled chunks are only kept around for reuse, so they go first
+    if (loadedBytes + pooledBytes > memoryBudget) {
+        size_t freed = chunkPool.Shrink(loadedBytes + pooledBytes - memoryBudget);
+        pooledBytes -= std::min(freed, pooledBytes);
+    }
+
+    residentBytes = loadedBytes + pooledBytes;
+    pooledChunkCount = chunkPool.Size();
+
+    if (budgetCooldown > 0) {
+        budgetCooldown--;
+        return;
+    }
+
+    if (residentBytes > memoryBudget) {
+        // Over budget with nothing left to free, pull the view in by one ring
+        if (effectiveRenderDistance > MIN_RENDER_DISTANCE || effectiveVerticalRenderDistance > MIN_RENDER_DISTANCE) {
+            if (effectiveRenderDistance >= effectiveVerticalRenderDistance && effectiveRenderDistance > MIN_RENDER_DISTANCE)
+                effectiveRenderDistance--;
+            else
+                effectiveVerticalRenderDistance--;
+
+            std::cout << "Chunk memory over budget (" << (residentBytes >> 20) << " MB), render distance reduced to "
+                << effectiveRenderDistance << "x" << effectiveVerticalRenderDistance << std::endl;
+            budgetCooldown = BUDGET_ADJUST_COOLDOWN_FRAMES;
+        }
+        return;
+    }
+
+    if (effectiveRenderDistance >= renderDistance && effectiveVerticalRenderDistance >= verticalRenderDistance)
+        return;
+
+    // Only grow if the next ring is predicted to fit using the current average chunk size
+    int nextHorizontal = std::min(effectiveRenderDistance + 1, renderDistance);
+    int nextVertical = std::min(effectiveVerticalRenderDistance + 1, verticalRenderDistance);
+    size_t averageBytes = loadedCount > 0 ? loadedBytes / loadedCount : sizeof(Chunk);
+    double predictedCount = (double)(2 * nextHorizontal + 1) * (2 * nextHorizontal + 1) * (2 * nextVertical);
+    if (sphericalRenderDistance)
+        predictedCount *= 0.5236; // Volume of an ellipsoid relative to its bounding box (pi / 6)
+
+    if (predictedCount * averageBytes < memoryBudget * 0.9) {
+        effectiveRenderDistance = nextHorizontal;
+        effectiveVerticalRenderDistance = nextVertical;
+        budgetCooldown = BUDGET_ADJUST_COOLDOWN_FRAMES;
+    }
+}
+
 void World::UpdateAsyncChunker() {
     auto chunkCoords = WorldToChunkCoordinates(m_cameraPosition);
+    int horizontal = effectiveRenderDistance;
+    int vertical = effectiveVerticalRenderDistance;
 
     // Check for chunks to unload
     {
         std::lock_guard<std::mutex> chunkLock(chunksMutex);
 
         std::vector<std::tuple<int, int, int>> tempUnloadList;
+        std::vector<std::unique_ptr<Chunk>> unloadedChunks;
+        size_t loadedBytes = 0;
 
         for (auto iterator = chunks.begin(); iterator != chunks.end(); ++iterator) {
             Chunk* pChunk = (*iterator).second.get();
             auto coords = pChunk->GetCoords();
 
-            int distX = abs((coords.x - chunkCoords.x));
-            int distY = abs((coords.y - chunkCoords.y));
-            int distZ = abs((coords.z - chunkCoords.z));
+            int distX = coords.x - chunkCoords.x;
+            int distY = coords.y - chunkCoords.y;
+            int distZ = coords.z - chunkCoords.z;
+
+            // Pooled chunks can be recycled at any time, so edits have to go out first.
+            // With the write queue full the chunk stays loaded until a later pass.
+            bool unload = !IsWithinRenderDistance(distX, distY, distZ, horizontal + 1, vertical + 1);
+            if (unload && chunkIO && pChunk->NeedsSaving() && !SaveChunkAsync(pChunk))
+                unload = false;
 
-            if (distX > RENDER_DISTANCE + 1 || distY > RENDER_DISTANCE + 1 || distZ > RENDER_DISTANCE + 1) {
+            if (unload) {
                 pChunk->UnloadChunk();
-                m_vpChunkUnloadedList.push_back(std::move((*iterator).second));
+                unloadedChunks.push_back(std::move((*iterator).second));
                 tempUnloadList.push_back((*iterator).first);
             }
+            else {
+                loadedBytes += pChunk->GetMemoryUsage();
+            }
         }
 
         for (auto iterator = tempUnloadList.begin(); iterator != tempUnloadList.end(); ++iterator) {
             chunks.erase(*iterator);
         }
+
+        if (!unloadedChunks.empty()) {
+            std::unordered_set<Chunk*> unloaded;
+            for (auto& pChunk : unloadedChunks)
+                unloaded.insert(pChunk.get());
+            ForgetChunks(unloaded);
+
+            // The world thread may still be using them from before they were unlinked
+            uint64_t retireEpoch = chunkReclaimer.Retire();
+            for (auto& pChunk : unloadedChunks)
+                chunkPool.Release(std::move(pChunk), retireEpoch);
+        }
+
+        UpdateMemoryBudget(loadedBytes, chunkPool.GetMemoryUsage(), chunks.size());
+        horizontal = effectiveRenderDistance;
+        vertical = effectiveVerticalRenderDistance;
     }
 
+    worldGenerator->Retain(chunkCoords.x, chunkCoords.z, horizontal + 2);
+
+    if (chunkIO)
+        PrefetchAhead(chunkCoords, horizontal, vertical);
+
     // Load new chunks
     int x, z, dx, dy;
     x = z = dx = 0;
     dy = -1;
-    int width = RENDER_DISTANCE * 2;
+    int width = horizontal * 2;
     int t = width;
     int maxI = t * t;
 
@@ -394,25 +577,40 @@ void World::UpdateAsyncChunker() {
 
     for (int i = 0; i < maxI; i++) {
         if ((-width / 2 <= x) && (x <= width / 2) && (-width / 2 <= z) && (z <= width / 2)) {
-            for (int y = -RENDER_DISTANCE; y < RENDER_DISTANCE; ++y) {
+            for (int y = -vertical; y < vertical; ++y) {
+                if (!IsWithinRenderDistance(x, y, z, horizontal, vertical))
+                    continue;
+
                 int chunkX = x + chunkCoords.x;
                 int chunkY = y + chunkCoords.y;
                 int chunkZ = z + chunkCoords.z;
                 auto key = std::make_tuple(chunkX, chunkY, chunkZ);
                 auto search = chunks.find(key);
                 if (search == chunks.end()) {
-                    if (!m_vpChunkUnloadedList.empty()) {
-                        chunks[key] = std::move(m_vpChunkUnloadedList.back());
-                        chunks[key]->Reset(chunkX, chunkY, chunkZ);
-                        m_vpChunkUnloadedList.pop_back();
-                    }
-                    else {
-                        chunks[key] = std::unique_ptr<Chunk>(new Chunk(this, chunkX, chunkY, chunkZ));
+                    // Prefer the chunk that used to be here, it only needs setting up again
+                    auto pChunk = chunkPool.Restore(chunkX, chunkY, chunkZ);
+                    if (!pChunk || !pChunk->RestoreChunk()) {
+                        if (!pChunk) {
+                            pChunk = chunkPool.Recycle();
+                        }
+                        if (pChunk) {
+                            pChunk->Reset(chunkX, chunkY, chunkZ);
+                        }
+                        else {
+                            pChunk = std::unique_ptr<Chunk>(new Chunk(this, chunkX, chunkY, chunkZ));
+                        }
                     }
-                    
+                    pChunk->SetLodLevel(SelectLodLevel(x, y, z, 0));
+                    chunks[key] = std::move(pChunk);
+
                     m_vpChunkLoadList.push_back(chunks[key].get());
                 }
                 else {
+                    // Meshed chunks are rebuilt at their new level
+                    Chunk* pChunk = search->second.get();
+                    if (pChunk->SetLodLevel(SelectLodLevel(x, y, z, pChunk->GetLodLevel())) && pChunk->IsSetup())
+                        pChunk->SetNeedsRebuilding(true);
+
                     if (!search->second->IsLoaded()) {
                         m_vpChunkLoadList.push_back(chunks[key].get());
                     }
@@ -435,6 +633,32 @@ void World::UpdateAsyncChunker() {
 }
 
 
+void World::ForgetChunks(const std::unordered_set<Chunk*>& unloaded) {
+    auto isUnloaded = [&unloaded](Chunk* pChunk) { return unloaded.count(pChunk) > 0; };
+
+    // Load and rebuild lists are filled here and read on the next world thread pass
+    {
+        std::lock_guard<std::mutex> lock(loadListMutex);
+        m_vpChunkLoadList.erase(std::remove_if(m_vpChunkLoadList.begin(), m_vpChunkLoadList.end(), isUnloaded), m_vpChunkLoadList.end());
+    }
+    {
+        std::lock_guard<std::mutex> lock(rebuildListMutex);
+        m_vpChunkRebuildList.erase(std::remove_if(m_vpChunkRebuildList.begin(), m_vpChunkRebuildList.end(), isUnloaded), m_vpChunkRebuildList.end());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(meshQueueMutex);
+        meshGenerationQueue.erase(std::remove_if(meshGenerationQueue.begin(), meshGenerationQueue.end(), isUnloaded), meshGenerationQueue.end());
+    }
+
+    // The visibility list is built by the world thread for this one, under chunksMutex.
+    // The render list is rebuilt from it this frame, but the memory budget can free
+    // chunks before that, so it's not left holding them in the meantime.
+    m_vpChunkVisibilityList.erase(std::remove_if(m_vpChunkVisibilityList.begin(), m_vpChunkVisibilityList.end(), isUnloaded), m_vpChunkVisibilityList.end());
+    m_vpChunkRenderList.erase(std::remove_if(m_vpChunkRenderList.begin(), m_vpChunkRenderList.end(), isUnloaded), m_vpChunkRenderList.end());
+    m_forceVisibilityUpdate = true;
+}
+
 void World::UpdateLoadList() {
     std::vector<Chunk*> tempLoadList;
     {
@@ -447,9 +671,39 @@ void World::UpdateLoadList() {
     int lNumOfChunksLoaded = 0;
 
     for (auto pChunk : tempLoadList) {
-        if (!pChunk->IsLoaded() && lNumOfChunksLoaded < ASYNC_NUM_CHUNKS_PER_FRAME) {
-            pChunk->LoadChunk(terrainGenerator);
-            lNumOfChunksLoaded++;
+        if (pChunk->IsLoaded() && !pChunk->IsSetup()) {
+            // Restored from the pool with its blocks intact
+            chunksToSetup.push_back(pChunk);
+        }
+        else if (!pChunk->IsLoaded() && lNumOfChunksLoaded < ASYNC_NUM_CHUNKS_PER_FRAME) {
+            auto coords = pChunk->GetCoords();
+            BlockType uniformType;
+            WorldSnapshot::MappedChunk mapped;
+
+            // Saved chunks take priority over anything the generator would produce
+            std::shared_ptr<const ChunkData> saved;
+            ChunkIO::LoadStatus savedStatus = chunkIO ? chunkIO->Load(coords.x, coords.y, coords.z, saved) : ChunkIO::LoadStatus::Missing;
+
+            if (savedStatus == ChunkIO::LoadStatus::Pending) {
+                // Still being read, the chunker queues it again next frame
+                continue;
+            }
+            else if (savedStatus == ChunkIO::LoadStatus::Found) {
+                pChunk->LoadSavedChunk(saved->blocks->data(), saved->occupancy);
+                lNumOfChunksLoaded++;
+            }
+            // Mapped chunks are only a pointer until they're edited, so they don't count either
+            else if (worldSnapshot && worldSnapshot->Find(coords.x, coords.y, coords.z, mapped)) {
+                pChunk->LoadMappedChunk(mapped.blocks, mapped.occupancy, mapped.mesh, mapped.meshSize, mapped.meshRanges);
+            }
+            // Chunks clear of the surface don't count against the per-frame limit
+            else if (worldGenerator->Classify(coords.x, coords.y, coords.z, uniformType)) {
+                pChunk->LoadUniform(uniformType);
+            }
+            else {
+                pChunk->LoadChunk(*worldGenerator);
+                lNumOfChunksLoaded++;
+            }
             m_forceVisibilityUpdate = true;
             chunksToSetup.push_back(pChunk);
         }
@@ -470,11 +724,29 @@ void World::UpdateSetupList() {
     }
 
     std::vector<Chunk*> chunksToRebuild;
+    std::vector<Chunk*> chunksToUpdateFlags;
 
     for (auto pChunk : tempSetupList) {
         if (!pChunk->IsSetup()) {
             pChunk->SetupChunk();
-            chunksToRebuild.push_back(pChunk);
+            if (pChunk->IsUniform() && (pChunk->IsEmpty() || IsUniformChunkCovered(pChunk))) {
+                // Nothing to mesh, but neighbours still need their surrounded flags
+                pChunk->SetNeedsRebuilding(false);
+                chunksToUpdateFlags.push_back(pChunk);
+            }
+            else if (pChunk->HasBakedMesh() && pChunk->GetLodLevel() == 0 && IsBakedMeshCurrent(pChunk)) {
+                // The mesh came with the snapshot, neighbours still need their surrounded flags
+                pChunk->SetNeedsRebuilding(false);
+                chunksToUpdateFlags.push_back(pChunk);
+                auto coords = pChunk->GetCoords();
+                for (int i = 0; i < 6; i++) {
+                    auto neighbour = GetChunk(coords.x + kNeighbourOffsets[i][0], coords.y + kNeighbourOffsets[i][1], coords.z + kNeighbourOffsets[i][2]);
+                    if (neighbour) chunksToUpdateFlags.push_back(neighbour);
+                }
+            }
+            else {
+                chunksToRebuild.push_back(pChunk);
+            }
             UpdateAdjacentChunks(pChunk);
             m_forceVisibilityUpdate = true;
         }
@@ -484,6 +756,11 @@ void World::UpdateSetupList() {
         std::lock_guard<std::mutex> lock(rebuildListMutex);
         m_vpChunkRebuildList.insert(m_vpChunkRebuildList.end(), chunksToRebuild.begin(), chunksToRebuild.end());
     }
+
+    if (!chunksToUpdateFlags.empty()) {
+        std::lock_guard<std::mutex> lock(flagsListMutex);
+        m_vpChunkUpdateFlagsList.insert(m_vpChunkUpdateFlagsList.end(), chunksToUpdateFlags.begin(), chunksToUpdateFlags.end());
+    }
 }
 
 void World::UpdateRebuildList() {
@@ -607,37 +884,272 @@ void World::UpdateRenderList() {
     //std::cout << "Render list size: " << m_vpChunkRenderList.size() << std::endl;
 }
 
-void World::Render(Shader& shader, glm::mat4& viewMatrix, glm::mat4& projectionMatrix, float frameWidth, float frameHeight, float time) {
+void World::Render(Shader& shader, float frameWidth, float frameHeight, float time) {
     shader.Use();
 
     glm::mat4 model = glm::mat4(1.0f);
 
     shader.SetUniform("time", time);
 
+    // View and projection come from the Camera block, chunk origins from the
+    // per-draw offsets
     shader.SetUniform("model", model);
-    shader.SetUniform("projection", projectionMatrix);
+    // Vertex positions are packed relative to the chunk size
+    glUniform1i(shader.GetUniformLocation("chunkSize"), Chunk::CHUNK_SIZE);
 
+    // Before the draw list is built, compaction moves meshes
+    vertexArena.Defragment();
+
+    drawList.Clear();
     for (auto iterator = m_vpChunkRenderList.begin(); iterator != m_vpChunkRenderList.end(); ++iterator) {
         Chunk* pChunk = *iterator;
-        
-        auto coords = pChunk->GetCoords();
-
-        glm::mat4 newViewMatrix = glm::translate(viewMatrix, glm::vec3(coords.x * Chunk::CHUNK_SIZE, coords.y * Chunk::CHUNK_SIZE, coords.z * Chunk::CHUNK_SIZE));
-        shader.SetUniform("view", newViewMatrix);
-
-        pChunk->Render(shader);
+        pChunk->AddToDrawList(vertexArena, drawList, m_cameraPosition);
     }
+    drawList.Build();
+
+    vertexArena.Draw(drawList);
 }
 
 void World::Stop() {
     running = false;
+    saveWake.notify_all();
+}
+
+void World::SaveThread() {
+    if (!worldStorage)
+        return;
+
+    auto lastFold = std::chrono::steady_clock::now();
+    while (running) {
+        {
+            std::unique_lock<std::mutex> lock(saveWakeMutex);
+            saveWake.wait_for(lock, std::chrono::seconds(1), [this] { return !running; });
+        }
+        if (!running) break;
+
+        bool intervalPassed = std::chrono::steady_clock::now() - lastFold >= std::chrono::seconds(JOURNAL_FOLD_SECONDS);
+        uint64_t journalSize = worldStorage->GetJournal().GetSize();
+        if (journalSize > 0 && (intervalPassed || journalSize >= JOURNAL_FOLD_BYTES)) {
+            FoldJournal();
+            lastFold = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+void World::SaveModifiedChunks() {
+    if (worldStorage)
+        FoldJournal();
+}
+
+void World::JournalEdits(const std::vector<BlockEdit>& edits) {
+    // Called from the render and world threads, the append happens on the I/O thread
+    if (chunkIO)
+        chunkIO->AppendJournal(edits);
+}
+
+void World::FoldJournal() {
+    std::lock_guard<std::mutex> foldLock(foldMutex);
+    EditJournal& journal = worldStorage->GetJournal();
+
+    // Edits from here on land in the new journal and are not covered by this fold
+    journal.Rotate();
+
+    std::vector<std::tuple<int, int, int>> dirtyChunks;
+    {
+        std::lock_guard<std::mutex> lock(chunksMutex);
+        for (auto iterator = chunks.begin(); iterator != chunks.end(); ++iterator) {
+            if ((*iterator).second->NeedsSaving())
+                dirtyChunks.push_back((*iterator).first);
+        }
+    }
+
+    // Only the snapshot happens under the lock, encoding and writing are left to the I/O thread
+    for (const auto& key : dirtyChunks) {
+        // Runs off the world and render threads, so it can wait out a full queue
+        while (!chunkIO->HasWriteRoom(std::get<0>(key), std::get<1>(key), std::get<2>(key)))
+            chunkIO->WaitForWriteRoom();
+
+        Chunk::BlockSnapshot snapshot;
+        {
+            std::lock_guard<std::mutex> lock(chunksMutex);
+            auto search = chunks.find(key);
+            // Unloaded chunks were queued on their way out
+            if (search == chunks.end() || !search->second->SnapshotForSave(snapshot))
+                continue;
+        }
+        chunkIO->Save(std::get<0>(key), std::get<1>(key), std::get<2>(key), std::make_shared<ChunkData>(ChunkData{ snapshot.storage, snapshot.occupancy }));
+    }
+
+    if (chunkIO->Flush())
+        journal.DiscardRotated();
+}
+
+bool World::SaveChunkAsync(Chunk* chunk) {
+    auto coords = chunk->GetCoords();
+    if (!chunkIO->HasWriteRoom(coords.x, coords.y, coords.z))
+        return false;
+
+    Chunk::BlockSnapshot snapshot;
+    if (chunk->SnapshotForSave(snapshot))
+        chunkIO->Save(coords.x, coords.y, coords.z, std::make_shared<ChunkData>(ChunkData{ snapshot.storage, snapshot.occupancy }));
+    return true;
+}
+
+void World::PrefetchAhead(glm::ivec3 center, int horizontal, int vertical) {
+    glm::ivec3 target = WorldToChunkCoordinates(m_cameraPosition + m_cameraVelocity * PREFETCH_SECONDS);
+    if (target == center || target == lastPrefetchTarget)
+        return;
+    lastPrefetchTarget = target;
+
+    // Only the part of the window around the predicted position that isn't already
+    // in range, chunks in range are read when they're loaded
+    for (int dx = -horizontal; dx <= horizontal; dx++) {
+        for (int dz = -horizontal; dz <= horizontal; dz++) {
+            for (int dy = -vertical; dy < vertical; dy++) {
+                if (!IsWithinRenderDistance(dx, dy, dz, horizontal, vertical))
+                    continue;
+
+                int chunkX = target.x + dx, chunkY = target.y + dy, chunkZ = target.z + dz;
+                if (IsWithinRenderDistance(chunkX - center.x, chunkY - center.y, chunkZ - center.z, horizontal + 1, vertical + 1))
+                    continue;
+
+                chunkIO->Prefetch(chunkX, chunkY, chunkZ);
+            }
+        }
+    }
+}
+
+void World::RequestSnapshotBake(const std::string& path) {
+    std::lock_guard<std::mutex> lock(snapshotBakeMutex);
+    snapshotBakePath = path;
+}
+
+int World::BakeSnapshot(const std::string& path) {
+    std::vector<WorldSnapshot::BakedChunk> baked;
+    {
+        // Held for the whole copy so no chunk is recycled under it, bakes are rare
+        std::lock_guard<std::mutex> lock(chunksMutex);
+        baked.reserve(chunks.size());
+
+        for (auto iterator = chunks.begin(); iterator != chunks.end(); ++iterator) {
+            Chunk* pChunk = (*iterator).second.get();
+            // Uniform chunks are classified again at no cost
+            if (!pChunk->IsLoaded() || pChunk->IsUniform())
+                continue;
+
+            // A mesh is only worth keeping if it was built against all of its neighbours
+            bool neighboursLoaded = true;
+            for (int i = 0; i < 6; i++) {
+                auto search = chunks.find(std::make_tuple(std::get<0>((*iterator).first) + kNeighbourOffsets[i][0],
+                    std::get<1>((*iterator).first) + kNeighbourOffsets[i][1],
+                    std::get<2>((*iterator).first) + kNeighbourOffsets[i][2]));
+                if (search == chunks.end() || !search->second->IsLoaded()) {
+                    neighboursLoaded = false;
+                    break;
+                }
+            }
+
+            WorldSnapshot::BakedChunk chunk;
+            chunk.chunkX = std::get<0>((*iterator).first);
+            chunk.chunkY = std::get<1>((*iterator).first);
+            chunk.chunkZ = std::get<2>((*iterator).first);
+            if (pChunk->CopyForSnapshot(chunk.blocks, chunk.occupancy, neighboursLoaded ? &chunk.mesh : nullptr, &chunk.meshRanges))
+                baked.push_back(std::move(chunk));
+        }
+    }
+
+    if (!WorldSnapshot::Write(path, baked))
+        return 0;
+
+    std::cout << "Baked " << baked.size() << " chunks into " << path << std::endl;
+    return (int)baked.size();
+}
+
+bool World::IsBakedMeshCurrent(Chunk* chunk) {
+    auto coords = chunk->GetCoords();
+    for (int i = 0; i < 6; i++) {
+        auto neighbour = GetChunk(coords.x + kNeighbourOffsets[i][0], coords.y + kNeighbourOffsets[i][1], coords.z + kNeighbourOffsets[i][2]);
+        // Neighbours loaded later rebuild it if they differ
+        if (neighbour && neighbour->IsLoaded() && !neighbour->IsMapped() && !neighbour->IsUniform())
+            return false;
+    }
+    return true;
+}
+
+bool World::IsBorderCovered(Chunk* chunk, Chunk* neighbour) {
+    glm::ivec3 offset = neighbour->GetCoords() - chunk->GetCoords();
+    int axis = offset.x != 0 ? 0 : (offset.y != 0 ? 1 : 2);
+
+    Chunk::LayerCulls culls;
+    neighbour->GetLayerCulls(axis, offset[axis] > 0 ? 0 : Chunk::CHUNK_SIZE - 1, culls);
+    for (uint64_t bits : culls) {
+        if (bits != ~0ull)
+            return false;
+    }
+    return true;
+}
+
+bool World::IsUniformChunkCovered(Chunk* chunk) {
+    auto coords = chunk->GetCoords();
+    for (int i = 0; i < 6; i++) {
+        auto neighbour = GetChunk(coords.x + kNeighbourOffsets[i][0], coords.y + kNeighbourOffsets[i][1], coords.z + kNeighbourOffsets[i][2]);
+        // Neighbours loaded later check the border again
+        if (neighbour && neighbour->IsLoaded() && !neighbour->IsFull() && !IsBorderCovered(chunk, neighbour))
+            return false;
+    }
+    return true;
+}
+
+bool World::GetChunkIOStats(ChunkIO::Stats& stats) {
+    if (!chunkIO)
+        return false;
+
+    stats = chunkIO->GetStats();
+    return true;
+}
+
+void World::ReplayJournal() {
+    std::vector<BlockEdit> edits;
+    worldStorage->GetJournal().ReadAll(edits);
+    if (edits.empty())
+        return;
+
+    std::map<std::tuple<int, int, int>, std::vector<BlockEdit>> editsByChunk;
+    for (const BlockEdit& edit : edits) {
+        auto chunkCoords = WorldToChunkCoordinates(edit.x, edit.y, edit.z);
+        editsByChunk[std::make_tuple(chunkCoords.x, chunkCoords.y, chunkCoords.z)].push_back(edit);
+    }
+
+    std::array<Block, Chunk::CHUNK_VOLUME> blocks;
+    bool allSaved = true;
+    for (const auto& pair : editsByChunk) {
+        int chunkX = std::get<0>(pair.first), chunkY = std::get<1>(pair.first), chunkZ = std::get<2>(pair.first);
+
+        BlockOccupancy occupancy;
+        if (!worldStorage->LoadChunk(chunkX, chunkY, chunkZ, blocks.data(), occupancy))
+            worldGenerator->FillChunk(chunkX, chunkY, chunkZ, blocks.data());
+
+        // In journal order, so later edits of a block win
+        for (const BlockEdit& edit : pair.second) {
+            auto blockCoords = WorldToBlockCoordinates(edit.x, edit.y, edit.z);
+            blocks[Chunk::Index(blockCoords.x, blockCoords.y, blockCoords.z)] = edit.block;
+        }
+
+        allSaved &= worldStorage->SaveChunk(chunkX, chunkY, chunkZ, blocks.data());
+    }
+
+    std::cout << "Recovered " << edits.size() << " block edits in " << editsByChunk.size() << " chunks from the edit journal" << std::endl;
+    if (allSaved)
+        worldStorage->GetJournal().Clear();
 }
 
 void World::RebuildAllChunks()
 {
     for (auto iterator = chunks.begin(); iterator != chunks.end(); ++iterator) {
         Chunk* pChunk = (*iterator).second.get();
-        pChunk->SetNeedsRebuilding(true);
+        if (!pChunk->IsUniform() || (!pChunk->IsEmpty() && !IsUniformChunkCovered(pChunk))) {
+            pChunk->SetNeedsRebuilding(true);
+        }
     }
 }
 
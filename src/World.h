@@ -9,33 +9,44 @@
 #include <chrono>
 #include <set>
 #include <future>
+#include <climits>
+#include <unordered_set>
 
 #include "Block.h"
 #include "Chunk.h"
-#include "TerrainGenerator.h"
+#include "ChunkPool.h"
+#include "EpochReclaimer.h"
+#include "WorldGenerator.h"
+#include "WorldStorage.h"
+#include "ChunkIO.h"
+#include "WorldSnapshot.h"
 #include "Camera.h"
 #include "ThreadPool.h"
 
-inline int cantor(int a, int b) {
-    return (a + b + 1) * (a + b) / 2 + b;
-}
-
-struct hash_tuple {
-    size_t operator()(const std::tuple<int, int, int>& x) const {
-        return cantor(std::get<0>(x), cantor(std::get<1>(x), std::get<2>(x)));
-    }
-};
-
 class Shader;
 
 class World
 {
 public:
-    static const int RENDER_DISTANCE = 4;
-
-    World(TerrainGenerator* terrainGenerator);
+    static const int DEFAULT_RENDER_DISTANCE = 4;
+    static const int DEFAULT_VERTICAL_RENDER_DISTANCE = 4;
+    static const int MIN_RENDER_DISTANCE = 1;
+    static const int MAX_RENDER_DISTANCE = 32;
+    static const size_t DEFAULT_MEMORY_BUDGET = 512ull * 1024 * 1024;
+    // Chunks at least this many chunks away are meshed at 2x and 4x coarser detail
+    static const int DEFAULT_LOD1_DISTANCE = 8;
+    static const int DEFAULT_LOD2_DISTANCE = 16;
+
+    // Without storage nothing is saved and every chunk is generated. Chunks in the
+    // snapshot are served from it unless they were saved since it was baked.
+    World(WorldGenerator* worldGenerator, WorldStorage* worldStorage = nullptr, WorldSnapshot* worldSnapshot = nullptr);
     World(const World& other);
+    // The chunk stays at these coordinates while the caller is the main thread, until
+    // its next Update, or the world thread, until the end of its current pass. Any
+    // other thread needs its own reader in the chunk reclaimer.
     Chunk* GetChunk(int chunkX, int chunkY, int chunkZ);
+    // Moves on every time chunks are unloaded, pointers from before may be stale
+    uint64_t GetChunkEpoch() const { return chunkReclaimer.GetEpoch(); }
 
     bool GetBlock(int x, int y, int z, Block& block);
     bool GetBlockCulls(int x, int y, int z);
@@ -51,22 +62,78 @@ public:
 
     void RebuildAllChunks();
 
-    void Render(Shader& shader, glm::mat4& viewMatrix, glm::mat4& projectionMatrix, float frameWidth, float frameHeight, float time);
+    void Render(Shader& shader, float frameWidth, float frameHeight, float time);
 
     void Stop();
+    // Folds the edit journal into the region files every so often
+    void SaveThread();
+    // Writes every edited chunk to storage, call once the world thread has stopped
+    void SaveModifiedChunks();
 
     void QueueMeshGeneration(Chunk* chunk);
     void ProcessMeshQueue();
 
-    TerrainGenerator* terrainGenerator;
+    // Render distance is measured in chunks. The effective distance can be lower
+    // than the requested one while the world is over its memory budget.
+    void SetRenderDistance(int horizontal, int vertical);
+    void SetSphericalRenderDistance(bool spherical);
+    void SetMemoryBudget(size_t bytes);
+    // 0 turns a level off. A chunk has to come one chunk closer than the distance
+    // to go back to a finer level, so chunks on a ring don't switch every frame.
+    void SetLodDistances(int lod1, int lod2);
+    int GetRenderDistance() const { return renderDistance; }
+    int GetVerticalRenderDistance() const { return verticalRenderDistance; }
+    int GetEffectiveRenderDistance() const { return effectiveRenderDistance; }
+    int GetEffectiveVerticalRenderDistance() const { return effectiveVerticalRenderDistance; }
+    bool IsSphericalRenderDistance() const { return sphericalRenderDistance; }
+    size_t GetMemoryBudget() const { return memoryBudget; }
+    int GetLodDistance(int level) const { return lodDistances[level - 1]; }
+    size_t GetResidentBytes() const { return residentBytes; }
+    size_t GetPooledChunkCount() const { return pooledChunkCount; }
+    // False when the world isn't saved
+    bool GetChunkIOStats(ChunkIO::Stats& stats);
+    MeshCache& GetMeshCache() { return meshCache; }
+
+    // Render thread only
+    const VertexArena& GetVertexArena() const { return vertexArena; }
+    size_t GetDrawCount() const { return drawList.Size(); }
+    size_t GetDrawBatchCount() const { return drawList.GetBatches().size(); }
+    const ChunkDrawList& GetDrawList() const { return drawList; }
+
+    // Bakes every loaded chunk, with its mesh where it's up to date, into a snapshot
+    // on the world thread. The file is used from the next start.
+    void RequestSnapshotBake(const std::string& path);
+    // -1 until a bake has finished, 0 if it failed
+    int GetLastSnapshotBakeCount() const { return lastSnapshotBakeCount; }
+
+    WorldGenerator* worldGenerator;
+    WorldStorage* worldStorage;
+    WorldSnapshot* worldSnapshot;
 
     void DebugFixChunk(glm::vec3 position);
     void DebugFixChunk(int chunkX, int chunkY, int chunkZ);
 
 private:
+    // Declared before the chunks so their meshes are freed back into it first
+    VertexArena vertexArena;
+    ChunkDrawList drawList;
+
     std::unordered_map<std::tuple<int, int, int>, std::unique_ptr<Chunk>, hash_tuple> chunks;
+    MeshCache meshCache;
 
     static const int ASYNC_NUM_CHUNKS_PER_FRAME = 25;
+    static const int BUDGET_ADJUST_COOLDOWN_FRAMES = 30;
+
+    int renderDistance = DEFAULT_RENDER_DISTANCE;
+    int verticalRenderDistance = DEFAULT_VERTICAL_RENDER_DISTANCE;
+    int effectiveRenderDistance = DEFAULT_RENDER_DISTANCE;
+    int effectiveVerticalRenderDistance = DEFAULT_VERTICAL_RENDER_DISTANCE;
+    bool sphericalRenderDistance = false;
+    size_t memoryBudget = DEFAULT_MEMORY_BUDGET;
+    int lodDistances[Chunk::MAX_LOD_LEVEL] = { DEFAULT_LOD1_DISTANCE, DEFAULT_LOD2_DISTANCE };
+    std::atomic<size_t> residentBytes{ 0 };
+    std::atomic<size_t> pooledChunkCount{ 0 };
+    int budgetCooldown = 0;
 
     static const int MESH_GENERATION_THREADS = 4; // Dedicated mesh generation threads
     ThreadPool meshThreadPool;
@@ -76,18 +143,33 @@ private:
     std::mutex meshQueueMutex;
 
     glm::vec3 m_cameraPosition, m_cameraView;
+    glm::vec3 m_cameraVelocity = glm::vec3(0.0f);
 
     std::vector<Chunk*> m_vpChunkLoadList, m_vpChunkSetupList, m_vpChunkRebuildList, m_vpChunkUpdateFlagsList, m_vpChunkVisibilityList, m_vpChunkRenderList;
-    std::vector<std::unique_ptr<Chunk>> m_vpChunkUnloadedList;
+    // Unloaded chunks go to the pool, which only reuses them once the world thread
+    // has been quiescent since
+    EpochReclaimer chunkReclaimer;
+    ChunkPool chunkPool{ chunkReclaimer };
 
     glm::ivec3 WorldToChunkCoordinates(glm::vec3 position);
     glm::ivec3 WorldToChunkCoordinates(int x, int y, int z);
     glm::ivec3 WorldToBlockCoordinates(int x, int y, int z);
     void UpdateAdjacentChunks(int x, int y, int z);
     void UpdateAdjacentChunks(Chunk* chunk);
+    // Whether the layer of neighbour touching chunk is all full cubes
+    bool IsBorderCovered(Chunk* chunk, Chunk* neighbour);
+    // Uniform solid chunks go unmeshed while every loaded neighbour covers them.
+    // Generated neighbours always do, saved, mapped or edited ones may not.
+    bool IsUniformChunkCovered(Chunk* chunk);
 
     // Main thread
     void UpdateAsyncChunker();
+    // Drops unloaded chunks from the lists that hand chunks between threads, called
+    // before they're retired so nothing can find them afterwards
+    void ForgetChunks(const std::unordered_set<Chunk*>& unloaded);
+    void UpdateMemoryBudget(size_t loadedBytes, size_t pooledBytes, size_t loadedCount);
+    bool IsWithinRenderDistance(int dx, int dy, int dz, int horizontal, int vertical) const;
+    int SelectLodLevel(int dx, int dy, int dz, int currentLevel) const;
     void UpdateRenderList();
 
     // Chunk thread
@@ -97,6 +179,7 @@ private:
     void UpdateFlagsList();
     void UpdateVisibilityList();
 
+
     std::mutex chunksMutex;
     std::mutex loadListMutex;
     std::mutex setupListMutex;
@@ -118,5 +201,36 @@ private:
 
     std::condition_variable workAvailable;
     std::mutex workMutex;
+
+    // The journal is folded on this interval, or sooner once it grows past the size limit
+    static const int JOURNAL_FOLD_SECONDS = 30;
+    static const uint64_t JOURNAL_FOLD_BYTES = 1024 * 1024;
+
+    std::condition_variable saveWake;
+    std::mutex saveWakeMutex;
+    std::mutex foldMutex;
+
+    // Saved chunks are read ahead this far along the camera's path
+    static constexpr float PREFETCH_SECONDS = 2.0f;
+
+    std::unique_ptr<ChunkIO> chunkIO;
+    glm::ivec3 lastPrefetchTarget = glm::ivec3(INT_MAX);
+
+    std::mutex snapshotBakeMutex;
+    std::string snapshotBakePath; // Empty unless a bake was requested
+    std::atomic<int> lastSnapshotBakeCount{ -1 };
+
+    int BakeSnapshot(const std::string& path);
+    // A baked mesh holds as long as its loaded neighbours are as they were baked
+    bool IsBakedMeshCurrent(Chunk* chunk);
+
+    void PrefetchAhead(glm::ivec3 center, int horizontal, int vertical);
+    // False if the write queue is full, the chunk stays dirty
+    bool SaveChunkAsync(Chunk* chunk);
+
+    void JournalEdits(const std::vector<BlockEdit>& edits);
+    void FoldJournal();
+    // Applies edits left in the journal by a crash to the saved chunks
+    void ReplayJournal();
 };
 
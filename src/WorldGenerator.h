@@ -0,0 +1,31 @@
+#pragma once
+#include <algorithm>
+
+#include "Block.h"
+
+// Decides the blocks of the world. Chunks ask for their whole volume at once
+// so implementations can share work across the chunk instead of per block.
+class WorldGenerator
+{
+public:
+    virtual ~WorldGenerator() = default;
+
+    // Writes the CHUNK_SIZE^3 blocks of a chunk, laid out as Chunk::Index, and
+    // returns their occupancy counted along the way
+    virtual BlockOccupancy FillChunk(int chunkX, int chunkY, int chunkZ, Block* blocks) = 0;
+
+    // Cheap test for chunks that are a single block type and fully enclosed or
+    // fully open, so they can skip FillChunk. Returns false when unsure.
+    virtual bool Classify(int /*chunkX*/, int /*chunkY*/, int /*chunkZ*/, BlockType& /*type*/) { return false; }
+
+    // Drops cached data for columns further than distance chunks from the center column
+    virtual void Retain(int /*centerX*/, int /*centerZ*/, int /*distance*/) {}
+
+protected:
+    // Fills blocks [begin, end) with one block
+    static void FillRange(Block* blocks, int begin, int end, const Block& block, BlockOccupancy& occupancy) {
+        if (end <= begin) return;
+        std::fill(blocks + begin, blocks + end, block);
+        occupancy.Add(block, end - begin);
+    }
+};
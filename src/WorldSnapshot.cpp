@@ -0,0 +1,259 @@
+#include "WorldSnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char SNAPSHOT_MAGIC[4] = { 'V', 'X', 'S', 'N' };
+
+// Blocks are used in place, so they have to be plain bytes
+static_assert(std::is_trivially_copyable<Block>::value, "Block must be trivially copyable to be mapped");
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+WorldSnapshot::~WorldSnapshot() {
+    Close();
+}
+
+bool WorldSnapshot::Open(const std::string& path) {
+    Close();
+
+    std::error_code error;
+    if (!std::filesystem::exists(path, error))
+        return false;
+
+    if (!Map(path)) {
+        std::cerr << "Error mapping world snapshot: " << path << std::endl;
+        return false;
+    }
+
+    Header header;
+    if (size < sizeof(Header)) {
+        std::cerr << "Error reading world snapshot: " << path << std::endl;
+        Close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(Header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, 4) != 0 || header.version != VERSION || header.blockSize != sizeof(Block)
+        || header.chunkSize != (uint32_t)Chunk::CHUNK_SIZE || header.blockOrder != (uint32_t)ChunkDimensions::ORDER
+        || (uint64_t)header.chunkCount * sizeof(Entry) > size - sizeof(Header)) {
+        std::cerr << "Error reading world snapshot, it may be from another build: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    const uint64_t blocksSize = (uint64_t)Chunk::CHUNK_VOLUME * sizeof(Block);
+    const Entry* entries = reinterpret_cast<const Entry*>(data + sizeof(Header));
+    index.reserve(header.chunkCount);
+    for (uint32_t i = 0; i < header.chunkCount; i++) {
+        const Entry& entry = entries[i];
+
+        // Nothing is copied out, so every range is checked once up front
+        bool valid = entry.blocksOffset <= size && blocksSize <= size - entry.blocksOffset;
+        if (entry.meshSize > 0) {
+            valid &= entry.meshOffset % alignof(uint32_t) == 0 && entry.meshOffset <= size
+                && (uint64_t)entry.meshSize * sizeof(uint32_t) <= size - entry.meshOffset;
+        }
+        // The face ranges have to cover the mesh exactly
+        uint64_t rangeVertices = 0;
+        for (uint32_t rangeSize : entry.meshRanges)
+            rangeVertices += rangeSize;
+        valid &= rangeVertices * VertexArena::VERTEX_WORDS == entry.meshSize;
+        if (!valid) {
+            std::cerr << "Error reading world snapshot, chunk " << i << " is out of bounds: " << path << std::endl;
+            Close();
+            return false;
+        }
+
+        index[std::make_tuple(entry.chunkX, entry.chunkY, entry.chunkZ)] = &entry;
+    }
+
+    return true;
+}
+
+void WorldSnapshot::Close() {
+    index.clear();
+    Unmap();
+}
+
+bool WorldSnapshot::Find(int chunkX, int chunkY, int chunkZ, MappedChunk& chunk) const {
+    auto search = index.find(std::make_tuple(chunkX, chunkY, chunkZ));
+    if (search == index.end())
+        return false;
+
+    const Entry& entry = *search->second;
+    chunk.blocks = reinterpret_cast<const Block*>(data + entry.blocksOffset);
+    chunk.occupancy.solidCount = entry.solidCount;
+    chunk.occupancy.fullCount = entry.fullCount;
+    chunk.mesh = entry.meshSize > 0 ? reinterpret_cast<const uint32_t*>(data + entry.meshOffset) : nullptr;
+    chunk.meshSize = entry.meshSize;
+    std::copy(std::begin(entry.meshRanges), std::end(entry.meshRanges), chunk.meshRanges.begin());
+    return true;
+}
+
+bool WorldSnapshot::Write(const std::string& path, const std::vector<BakedChunk>& chunks) {
+    Header header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+    header.version = VERSION;
+    header.chunkCount = (uint32_t)chunks.size();
+    header.blockSize = sizeof(Block);
+    header.chunkSize = Chunk::CHUNK_SIZE;
+    header.blockOrder = (uint32_t)ChunkDimensions::ORDER;
+
+    // Block arrays follow the table back to back, then the meshes
+    const uint64_t blocksSize = (uint64_t)Chunk::CHUNK_VOLUME * sizeof(Block);
+    std::vector<Entry> entries(chunks.size());
+    uint64_t offset = sizeof(Header) + chunks.size() * sizeof(Entry);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (chunks[i].blocks.size() != (size_t)Chunk::CHUNK_VOLUME) {
+            std::cerr << "Error writing world snapshot, chunk " << i << " has the wrong size" << std::endl;
+            return false;
+        }
+
+        entries[i].chunkX = chunks[i].chunkX;
+        entries[i].chunkY = chunks[i].chunkY;
+        entries[i].chunkZ = chunks[i].chunkZ;
+        entries[i].solidCount = chunks[i].occupancy.solidCount;
+        entries[i].fullCount = chunks[i].occupancy.fullCount;
+        entries[i].blocksOffset = offset;
+        offset += blocksSize;
+    }
+
+    offset = AlignUp(offset, alignof(uint32_t));
+    for (size_t i = 0; i < chunks.size(); i++) {
+        entries[i].meshSize = (uint32_t)chunks[i].mesh.size();
+        std::copy(chunks[i].meshRanges.begin(), chunks[i].meshRanges.end(), entries[i].meshRanges);
+        entries[i].meshOffset = chunks[i].mesh.empty() ? 0 : offset;
+        offset += chunks[i].mesh.size() * sizeof(uint32_t);
+    }
+
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        out.write((const char*)&header, sizeof(Header));
+        out.write((const char*)entries.data(), entries.size() * sizeof(Entry));
+        for (const BakedChunk& chunk : chunks)
+            out.write((const char*)chunk.blocks.data(), blocksSize);
+
+        // Padding up to the first mesh
+        uint64_t written = sizeof(Header) + entries.size() * sizeof(Entry) + chunks.size() * blocksSize;
+        static const char padding[alignof(uint32_t)] = {};
+        out.write(padding, AlignUp(written, alignof(uint32_t)) - written);
+
+        for (const BakedChunk& chunk : chunks)
+            out.write((const char*)chunk.mesh.data(), chunk.mesh.size() * sizeof(uint32_t));
+
+        if (!out) {
+            std::cerr << "Error writing world snapshot: " << temporaryPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::cerr << "Error replacing world snapshot: " << path << " (" << error.message() << ")" << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    return true;
+}
+
+#ifdef _WIN32
+
+bool WorldSnapshot::Map(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    size = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+void WorldSnapshot::Unmap() {
+    if (data)
+        UnmapViewOfFile(data);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+
+    data = nullptr;
+    size = 0;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+#else
+
+bool WorldSnapshot::Map(const std::string& path) {
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (view == MAP_FAILED)
+        return false;
+
+    data = static_cast<const uint8_t*>(view);
+    size = (size_t)status.st_size;
+    return true;
+}
+
+void WorldSnapshot::Unmap() {
+    if (data)
+        munmap(const_cast<uint8_t*>(data), size);
+
+    data = nullptr;
+    size = 0;
+}
+
+#endif
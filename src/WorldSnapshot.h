@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+
+// A baked, read-only copy of part of a world, laid out so chunks can be used
+// straight from a memory mapping of the file. The file is a header, a table with
+// one entry per chunk, then each chunk's blocks and optionally its mesh, all in
+// the in-memory format of this build, so a snapshot isn't portable between builds.
+class WorldSnapshot
+{
+public:
+    static const uint32_t VERSION = 6;
+
+    // One chunk as it goes into a snapshot
+    struct BakedChunk {
+        int chunkX, chunkY, chunkZ;
+        std::vector<Block> blocks;
+        BlockOccupancy occupancy;
+        std::vector<uint32_t> mesh; // Empty if the mesh wasn't baked
+        ChunkDrawList::FaceRanges meshRanges{};
+    };
+
+    // A chunk served from the mapping, valid for as long as the snapshot is open
+    struct MappedChunk {
+        const Block* blocks;
+        BlockOccupancy occupancy;
+        const uint32_t* mesh; // Null if the mesh wasn't baked
+        size_t meshSize;
+        ChunkDrawList::FaceRanges meshRanges;
+    };
+
+    WorldSnapshot() = default;
+    ~WorldSnapshot();
+    WorldSnapshot(const WorldSnapshot&) = delete;
+    WorldSnapshot& operator=(const WorldSnapshot&) = delete;
+
+    // Maps the file and indexes its chunks, fails quietly if there is no file
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return data != nullptr; }
+
+    bool Find(int chunkX, int chunkY, int chunkZ, MappedChunk& chunk) const;
+    size_t GetChunkCount() const { return index.size(); }
+    size_t GetMappedBytes() const { return size; }
+
+    // Written to a temporary file first and renamed over the path. On Windows that
+    // fails while the path is mapped.
+    static bool Write(const std::string& path, const std::vector<BakedChunk>& chunks);
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t chunkCount;
+        uint32_t blockSize; // sizeof(Block) of the build that baked it
+        uint32_t chunkSize; // Chunk::CHUNK_SIZE of the build that baked it
+        uint32_t blockOrder; // Its BlockOrder, the blocks are mapped in that layout
+    };
+
+    struct Entry {
+        int32_t chunkX, chunkY, chunkZ;
+        int32_t solidCount, fullCount;
+        uint32_t meshSize;
+        uint32_t meshRanges[ChunkDrawList::FACE_RANGE_COUNT]; // In vertices
+        uint64_t blocksOffset;
+        uint64_t meshOffset;
+    };
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    std::unordered_map<std::tuple<int, int, int>, const Entry*, hash_tuple> index;
+
+    bool Map(const std::string& path);
+    void Unmap();
+};
@@ -0,0 +1,111 @@
+#include "WorldStorage.h"
+
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "ChunkCodec.h"
+
+static int FloorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+WorldStorage::WorldStorage(const std::string& directory) : directory(directory) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+        std::cerr << "Error creating save directory: " << directory << " (" << error.message() << ")" << std::endl;
+
+    journal = std::make_unique<EditJournal>(directory);
+}
+
+bool WorldStorage::LoadChunk(int chunkX, int chunkY, int chunkZ, Block* blocks, BlockOccupancy& occupancy) {
+    const int size = RegionFile::REGION_SIZE;
+    std::vector<uint8_t> payload;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        RegionFile* region = GetRegion(FloorDiv(chunkX, size), FloorDiv(chunkY, size), FloorDiv(chunkZ, size), false);
+        if (!region)
+            return false;
+
+        int index = RegionFile::EntryIndex(chunkX - FloorDiv(chunkX, size) * size, chunkY - FloorDiv(chunkY, size) * size,
+            chunkZ - FloorDiv(chunkZ, size) * size);
+        if (!region->Has(index) || !region->Read(index, payload))
+            return false;
+    }
+    bytesRead += payload.size();
+
+    if (!ChunkCodec::Decode(payload.data(), payload.size(), blocks, occupancy)) {
+        std::cerr << "Error decoding saved chunk (" << chunkX << "," << chunkY << "," << chunkZ << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WorldStorage::SaveChunk(int chunkX, int chunkY, int chunkZ, const Block* blocks) {
+    const int size = RegionFile::REGION_SIZE;
+    std::vector<uint8_t> payload;
+    ChunkCodec::Encode(blocks, payload);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    RegionFile* region = GetRegion(FloorDiv(chunkX, size), FloorDiv(chunkY, size), FloorDiv(chunkZ, size), true);
+    if (!region)
+        return false;
+
+    int index = RegionFile::EntryIndex(chunkX - FloorDiv(chunkX, size) * size, chunkY - FloorDiv(chunkY, size) * size,
+        chunkZ - FloorDiv(chunkZ, size) * size);
+    if (!region->Write(index, payload))
+        return false;
+
+    bytesWritten += payload.size();
+    return true;
+}
+
+bool WorldStorage::HasChunk(int chunkX, int chunkY, int chunkZ) {
+    const int size = RegionFile::REGION_SIZE;
+    std::lock_guard<std::mutex> lock(mutex);
+    RegionFile* region = GetRegion(FloorDiv(chunkX, size), FloorDiv(chunkY, size), FloorDiv(chunkZ, size), false);
+    if (!region)
+        return false;
+
+    int index = RegionFile::EntryIndex(chunkX - FloorDiv(chunkX, size) * size, chunkY - FloorDiv(chunkY, size) * size,
+        chunkZ - FloorDiv(chunkZ, size) * size);
+    return region->Has(index);
+}
+
+bool WorldStorage::IsKnownMissing(int chunkX, int chunkY, int chunkZ) {
+    const int size = RegionFile::REGION_SIZE;
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+
+    auto search = regions.find(std::make_tuple(FloorDiv(chunkX, size), FloorDiv(chunkY, size), FloorDiv(chunkZ, size)));
+    if (search == regions.end())
+        return false;
+    if (!search->second)
+        return true;
+
+    int index = RegionFile::EntryIndex(chunkX - FloorDiv(chunkX, size) * size, chunkY - FloorDiv(chunkY, size) * size,
+        chunkZ - FloorDiv(chunkZ, size) * size);
+    return !search->second->Has(index);
+}
+
+RegionFile* WorldStorage::GetRegion(int regionX, int regionY, int regionZ, bool create) {
+    auto key = std::make_tuple(regionX, regionY, regionZ);
+    auto search = regions.find(key);
+    if (search != regions.end() && (search->second || !create))
+        return search->second.get();
+
+    // Closing everything is simpler than tracking use, reopening a region only reads its table
+    if (regions.size() >= MAX_OPEN_REGIONS)
+        regions.clear();
+
+    std::string path = directory + "/r." + std::to_string(regionX) + "." + std::to_string(regionY) + "." + std::to_string(regionZ) + ".region";
+    auto region = std::make_unique<RegionFile>(path, (uint32_t)Chunk::CHUNK_SIZE);
+    if (!region->Open(create))
+        region.reset();
+
+    RegionFile* result = region.get();
+    regions[key] = std::move(region);
+    return result;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+#include "Chunk.h"
+#include "EditJournal.h"
+#include "RegionFile.h"
+
+// Saved chunks of a world, kept as region files in one directory
+class WorldStorage
+{
+public:
+    WorldStorage(const std::string& directory);
+
+    // Fails if the chunk was never saved or its record is unreadable
+    bool LoadChunk(int chunkX, int chunkY, int chunkZ, Block* blocks, BlockOccupancy& occupancy);
+    bool SaveChunk(int chunkX, int chunkY, int chunkZ, const Block* blocks);
+    // Whether the chunk has a record, without reading it
+    bool HasChunk(int chunkX, int chunkY, int chunkZ);
+    // True only if it can be told without going to the disk, and whoever holds
+    // the storage isn't busy with it
+    bool IsKnownMissing(int chunkX, int chunkY, int chunkZ);
+
+    uint64_t GetBytesRead() const { return bytesRead; }
+    uint64_t GetBytesWritten() const { return bytesWritten; }
+
+    EditJournal& GetJournal() { return *journal; }
+
+private:
+    // Open file handles are capped for long trips across the world
+    static const size_t MAX_OPEN_REGIONS = 64;
+
+    std::string directory;
+    std::unique_ptr<EditJournal> journal;
+
+    std::mutex mutex;
+    std::atomic<uint64_t> bytesRead{ 0 };
+    std::atomic<uint64_t> bytesWritten{ 0 };
+    // A null region is known to not exist on disk yet
+    std::unordered_map<std::tuple<int, int, int>, std::unique_ptr<RegionFile>, hash_tuple> regions;
+
+    RegionFile* GetRegion(int regionX, int regionY, int regionZ, bool create);
+};
@@ -0,0 +1,264 @@
+// Headless world tool, generates worlds into region files and checks them without a display
+//
+//   WorldTool generate <save dir> [--density] [--center X Z] [--radius N] [--min-y N] [--max-y N] [--threads N]
+//   WorldTool verify <save dir> [--threads N]
+//   WorldTool layouts [--density]
+//
+// Coordinates and distances are in chunks. Chunks already in the save are left alone,
+// so a world can be generated further out without losing edits.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ChunkCodec.h"
+#include "DensityGenerator.h"
+#include "HeightmapGenerator.h"
+#include "LayoutBenchmark.h"
+#include "RegionFile.h"
+#include "TerrainGenerator.h"
+#include "WorldStorage.h"
+
+struct Options {
+    std::string command;
+    std::string directory;
+    bool useDensity = false;
+    int centerX = 0;
+    int centerZ = 0;
+    int radius = 32;
+    int minY = -8;
+    int maxY = 16;
+    unsigned int threads = 0;
+};
+
+static void PrintUsage() {
+    std::cerr << "Usage:" << std::endl
+              << "  WorldTool generate <save dir> [--density] [--center X Z] [--radius N] [--min-y N] [--max-y N] [--threads N]" << std::endl
+              << "  WorldTool verify <save dir> [--threads N]" << std::endl
+              << "  WorldTool layouts [--density]" << std::endl;
+}
+
+static bool ParseInt(const char* text, int& value) {
+    char* end;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0')
+        return false;
+
+    value = (int)parsed;
+    return true;
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    if (argc < 2)
+        return false;
+
+    // Benchmarks only generate in memory, everything else works on a save
+    options.command = argv[1];
+    int first = 2;
+    if (options.command != "layouts") {
+        if (argc < 3)
+            return false;
+        options.directory = argv[2];
+        first = 3;
+    }
+
+    for (int i = first; i < argc; i++) {
+        bool valid = true;
+        if (strcmp(argv[i], "--density") == 0) {
+            options.useDensity = true;
+        }
+        else if (strcmp(argv[i], "--center") == 0 && i + 2 < argc) {
+            valid = ParseInt(argv[i + 1], options.centerX) && ParseInt(argv[i + 2], options.centerZ);
+            i += 2;
+        }
+        else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc) {
+            valid = ParseInt(argv[++i], options.radius) && options.radius >= 0;
+        }
+        else if (strcmp(argv[i], "--min-y") == 0 && i + 1 < argc) {
+            valid = ParseInt(argv[++i], options.minY);
+        }
+        else if (strcmp(argv[i], "--max-y") == 0 && i + 1 < argc) {
+            valid = ParseInt(argv[++i], options.maxY);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int threads;
+            valid = ParseInt(argv[++i], threads) && threads > 0;
+            options.threads = (unsigned int)threads;
+        }
+        else {
+            valid = false;
+        }
+
+        if (!valid) {
+            std::cerr << "Invalid argument: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+
+    if (options.threads == 0)
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    return options.minY <= options.maxY;
+}
+
+// Runs work(index) for every index in [0, count) spread over the threads
+template <typename Work>
+static void RunParallel(unsigned int threadCount, size_t count, Work work) {
+    std::atomic<size_t> next{ 0 };
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < threadCount; i++) {
+        threads.emplace_back([&] {
+            for (size_t index = next++; index < count; index = next++)
+                work(index);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int Generate(const Options& options) {
+    TerrainGenerator terrainGenerator;
+    HeightmapGenerator heightmapGenerator(&terrainGenerator);
+    DensityGenerator densityGenerator(&terrainGenerator);
+    WorldGenerator* generator = options.useDensity ? static_cast<WorldGenerator*>(&densityGenerator) : &heightmapGenerator;
+    WorldStorage storage(options.directory);
+
+    // Threads take whole columns so each heightmap is only generated once
+    int width = 2 * options.radius + 1;
+    size_t columnCount = (size_t)width * width;
+
+    std::atomic<uint64_t> generated{ 0 }, uniform{ 0 }, skipped{ 0 }, failed{ 0 };
+    std::atomic<size_t> columnsDone{ 0 };
+    auto start = std::chrono::steady_clock::now();
+
+    RunParallel(options.threads, columnCount, [&](size_t column) {
+        int chunkX = options.centerX - options.radius + (int)(column % width);
+        int chunkZ = options.centerZ - options.radius + (int)(column / width);
+        std::vector<Block> blocks(Chunk::CHUNK_VOLUME);
+
+        for (int chunkY = options.minY; chunkY <= options.maxY; chunkY++) {
+            // Uniform chunks are classified again when they're loaded, saving them gains nothing
+            BlockType type;
+            if (generator->Classify(chunkX, chunkY, chunkZ, type)) {
+                uniform++;
+                continue;
+            }
+            if (storage.HasChunk(chunkX, chunkY, chunkZ)) {
+                skipped++;
+                continue;
+            }
+
+            generator->FillChunk(chunkX, chunkY, chunkZ, blocks.data());
+            if (storage.SaveChunk(chunkX, chunkY, chunkZ, blocks.data()))
+                generated++;
+            else
+                failed++;
+        }
+
+        size_t done = ++columnsDone;
+        if (done % 1024 == 0)
+            std::cout << done << " / " << columnCount << " columns" << std::endl;
+    });
+
+    double seconds = SecondsSince(start);
+    // Uniform and already saved chunks cost next to nothing, so they get their own rate
+    uint64_t chunkCount = generated + uniform + skipped;
+    std::cout << "Generated " << generated << " chunks, " << uniform << " uniform, " << skipped << " already saved, "
+              << failed << " failed" << std::endl;
+    std::cout << "Wrote " << storage.GetBytesWritten() / 1024 << " KB in " << seconds << " s ("
+              << (seconds > 0 ? generated / seconds : 0.0) << " generated chunks/s, "
+              << (seconds > 0 ? chunkCount / seconds : 0.0) << " chunks/s visited, " << options.threads << " threads)" << std::endl;
+
+    return failed > 0 ? 1 : 0;
+}
+
+static int Verify(const Options& options) {
+    std::vector<std::string> paths;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(options.directory, error)) {
+        if (entry.path().extension() == ".region")
+            paths.push_back(entry.path().string());
+    }
+    if (error) {
+        std::cerr << "Error reading save directory: " << options.directory << " (" << error.message() << ")" << std::endl;
+        return 1;
+    }
+
+    std::atomic<uint64_t> valid{ 0 }, corrupt{ 0 }, bytesRead{ 0 };
+    std::atomic<int> unreadableRegions{ 0 };
+    auto start = std::chrono::steady_clock::now();
+
+    // Regions are independent files, so each thread checks whole regions
+    RunParallel(options.threads, paths.size(), [&](size_t index) {
+        RegionFile region(paths[index], (uint32_t)Chunk::CHUNK_SIZE);
+        if (!region.Open(false)) {
+            unreadableRegions++;
+            return;
+        }
+
+        std::vector<uint8_t> payload;
+        std::vector<Block> blocks(Chunk::CHUNK_VOLUME);
+        for (int entry = 0; entry < RegionFile::ENTRY_COUNT; entry++) {
+            if (!region.Has(entry))
+                continue;
+
+            // Read checks the record's checksum, decoding checks the payload itself
+            BlockOccupancy occupancy;
+            if (region.Read(entry, payload) && ChunkCodec::Decode(payload.data(), payload.size(), blocks.data(), occupancy)) {
+                valid++;
+            }
+            else {
+                std::cerr << "Corrupt chunk " << entry << " in " << paths[index] << std::endl;
+                corrupt++;
+            }
+            bytesRead += payload.size();
+        }
+    });
+
+    double seconds = SecondsSince(start);
+    std::cout << "Checked " << paths.size() << " regions, " << valid << " chunks valid, " << corrupt << " corrupt, "
+              << unreadableRegions << " regions unreadable" << std::endl;
+    std::cout << "Read " << bytesRead / 1024 << " KB in " << seconds << " s ("
+              << (seconds > 0 ? (valid + corrupt) / seconds : 0.0) << " chunks/s, " << options.threads << " threads)" << std::endl;
+
+    return corrupt > 0 || unreadableRegions > 0 ? 1 : 0;
+}
+
+static int Layouts(const Options& options) {
+    TerrainGenerator terrainGenerator;
+    HeightmapGenerator heightmapGenerator(&terrainGenerator);
+    DensityGenerator densityGenerator(&terrainGenerator);
+    WorldGenerator* generator = options.useDensity ? static_cast<WorldGenerator*>(&densityGenerator) : &heightmapGenerator;
+
+    int surfaceChunkY = ChunkDimensions::ToChunk((int)terrainGenerator.GetHeight(0, 0));
+    BlockLayoutBenchmark result = BenchmarkBlockLayouts(*generator, surfaceChunkY);
+    return result.identical ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (options.command == "generate")
+        return Generate(options);
+    if (options.command == "verify")
+        return Verify(options);
+    if (options.command == "layouts")
+        return Layouts(options);
+
+    PrintUsage();
+    return 2;
+}
@@ -0,0 +1,138 @@
+// Runs BufferAllocator against a plain array of owners, one per unit, through
+// random allocations, frees and defragments. Exits with 1 if anything failed.
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "BufferAllocator.h"
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what, int step) {
+    if (condition)
+        return;
+    std::cerr << "Step " << step << ": " << what << std::endl;
+    failures++;
+}
+
+// Longest run of unowned units
+static uint32_t LongestFreeRun(const std::vector<int>& owners) {
+    uint32_t longest = 0, run = 0;
+    for (int owner : owners) {
+        run = owner < 0 ? run + 1 : 0;
+        longest = std::max(longest, run);
+    }
+    return longest;
+}
+
+static void CheckMerging() {
+    BufferAllocator allocator(100);
+    uint32_t offsets[10];
+    for (int i = 0; i < 10; i++)
+        offsets[i] = allocator.Allocate(10);
+    Check(allocator.GetStats().freeRangeCount == 0, "full buffer has a free range", 0);
+
+    allocator.Free(offsets[1]);
+    allocator.Free(offsets[3]);
+    Check(allocator.GetStats().freeRangeCount == 2, "separate frees merged", 0);
+
+    // Joins both neighbours into one range
+    allocator.Free(offsets[2]);
+    BufferAllocator::Stats stats = allocator.GetStats();
+    Check(stats.freeRangeCount == 1 && stats.largestFreeRange == 30, "free didn't merge with both neighbours", 0);
+    Check(allocator.Allocate(30) == offsets[1], "merged range not used whole", 0);
+    Check(allocator.Allocate(1) == BufferAllocator::INVALID_OFFSET, "allocated past capacity", 0);
+}
+
+static void CheckRandom() {
+    const uint32_t capacity = 4096;
+    BufferAllocator allocator(capacity);
+    std::vector<int> owners(capacity, -1);
+    std::map<int, std::pair<uint32_t, uint32_t>> live; // Owner to offset and size
+    uint32_t allocatedUnits = 0;
+    int nextOwner = 0;
+
+    std::mt19937 random(12345);
+    for (int step = 1; step <= 100000; step++) {
+        int action = random() % 16;
+
+        if (action < 9) {
+            // Mostly small, sometimes larger than any run left
+            uint32_t size = 1 + random() % (random() % 8 == 0 ? 512 : 48);
+            uint32_t longest = LongestFreeRun(owners);
+            uint32_t offset = allocator.Allocate(size);
+            if (offset == BufferAllocator::INVALID_OFFSET) {
+                Check(longest < size, "allocation failed with a free run that fits", step);
+                continue;
+            }
+
+            Check(offset + size <= capacity, "allocation past the end", step);
+            bool overlaps = false;
+            for (uint32_t unit = offset; unit < offset + size && unit < capacity; unit++) {
+                overlaps |= owners[unit] >= 0;
+                owners[unit] = nextOwner;
+            }
+            Check(!overlaps, "allocation overlaps another", step);
+            live[nextOwner++] = std::make_pair(offset, size);
+            allocatedUnits += size;
+        }
+        else if (action < 15) {
+            if (live.empty())
+                continue;
+            auto victim = std::next(live.begin(), random() % live.size());
+            uint32_t offset = victim->second.first, size = victim->second.second;
+            Check(allocator.GetSize(offset) == size, "size of a live allocation changed", step);
+            allocator.Free(offset);
+            for (uint32_t unit = offset; unit < offset + size; unit++)
+                owners[unit] = -1;
+            allocatedUnits -= size;
+            live.erase(victim);
+        }
+        else {
+            std::vector<BufferAllocator::Move> moves = allocator.Defragment(random() % 1024);
+            for (size_t i = 0; i < moves.size(); i++) {
+                const BufferAllocator::Move& move = moves[i];
+                Check(move.to < move.from, "move doesn't go towards the start", step);
+                // Any order of copies has to give the same result
+                for (const BufferAllocator::Move& other : moves) {
+                    Check(move.to + move.size <= other.from || other.from + other.size <= move.to, "move overlaps a source", step);
+                }
+            }
+
+            // Copied back to front, the reverse of the order they came in
+            std::vector<int> copied = owners;
+            for (auto move = moves.rbegin(); move != moves.rend(); ++move) {
+                int owner = owners[move->from];
+                for (uint32_t unit = 0; unit < move->size; unit++) {
+                    copied[move->from + unit] = -1;
+                    copied[move->to + unit] = owner;
+                }
+                live[owner].first = move->to;
+                Check(allocator.GetSize(move->to) == move->size, "moved allocation has another size", step);
+            }
+            owners = copied;
+        }
+
+        Check(allocator.GetAllocatedUnits() == allocatedUnits, "allocated units don't add up", step);
+        if (failures > 20)
+            return;
+    }
+
+    // Every allocation still holds its own units
+    for (const auto& allocation : live) {
+        for (uint32_t unit = 0; unit < allocation.second.second; unit++)
+            Check(owners[allocation.second.first + unit] == allocation.first, "allocation lost its units", 0);
+    }
+}
+
+int main() {
+    CheckMerging();
+    CheckRandom();
+
+    if (failures == 0)
+        std::cout << "Buffer allocator matches the reference" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+// Builds draw lists on the CPU and checks the commands, offsets and batches they
+// come out as, and which face ranges are picked for a camera. Exits with 1 if
+// anything failed.
+#include <iostream>
+
+#include "ChunkDrawList.h"
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what) {
+    if (condition)
+        return;
+    std::cerr << what << std::endl;
+    failures++;
+}
+
+static bool SameCommand(const ChunkDrawList::DrawCommand& command, uint32_t count, uint32_t first, uint32_t baseInstance) {
+    return command.count == count && command.instanceCount == 1 && command.first == first && command.baseInstance == baseInstance;
+}
+
+static void CheckBuild() {
+    ChunkDrawList list;
+    list.Add(1, 100, 30, 16, 0, 0);
+    list.Add(0, 0, 60, 0, 0, 0);
+    list.Add(1, 200, 90, 32, 0, 0);
+    list.Add(0, 60, 0, 48, 0, 0); // Empty, left out
+    list.Add(2, 10, 6, 0, 16, 0);
+    list.Build();
+
+    const auto& commands = list.GetCommands();
+    const auto& offsets = list.GetOffsets();
+    const auto& batches = list.GetBatches();
+    Check(list.Size() == 4 && offsets.size() == 4, "empty draw wasn't left out");
+    Check(list.GetVertexCount() == 186, "vertex count doesn't add up");
+    if (list.Size() != 4 || batches.size() != 3) {
+        Check(false, "wrong number of commands or batches");
+        return;
+    }
+
+    // By page, and in the order they were added within one
+    Check(SameCommand(commands[0], 60, 0, 0), "page 0 draw out of place");
+    Check(SameCommand(commands[1], 30, 100, 1) && SameCommand(commands[2], 90, 200, 2), "page 1 draws out of order");
+    Check(SameCommand(commands[3], 6, 10, 3), "page 2 draw out of place");
+    Check(offsets[1].x == 16 && offsets[2].x == 32 && offsets[3].y == 16, "offsets don't follow their draws");
+
+    Check(batches[0].page == 0 && batches[0].firstCommand == 0 && batches[0].commandCount == 1, "page 0 batch wrong");
+    Check(batches[1].page == 1 && batches[1].firstCommand == 1 && batches[1].commandCount == 2, "page 1 batch wrong");
+    Check(batches[2].page == 2 && batches[2].firstCommand == 3 && batches[2].commandCount == 1, "page 2 batch wrong");
+
+    list.Clear();
+    list.Build();
+    Check(list.Size() == 0 && list.GetBatches().empty() && list.GetVertexCount() == 0, "clear left draws behind");
+}
+
+static void CheckVisibleFaceRanges() {
+    const uint32_t all = (1u << ChunkDrawList::FACE_RANGE_COUNT) - 1;
+    const uint32_t sloped = 1u << ChunkDrawList::SLOPED_FACE_RANGE;
+    auto visible = [](float x, float y, float z) { return ChunkDrawList::VisibleFaceRanges(16, -32, 0, 16, x, y, z); };
+
+    Check(visible(24.0f, -24.0f, 8.0f) == all, "camera inside the chunk doesn't see every range");
+
+    // Faces lie on planes within the bounds, so a camera on the boundary plane sees them edge on
+    Check(visible(16.0f, -24.0f, 8.0f) == (all & ~1u), "camera on min x sees +X faces");
+    Check(visible(32.0f, -24.0f, 8.0f) == (all & ~2u), "camera on min x + size sees -X faces");
+    Check(visible(16.5f, -24.0f, 8.0f) == all, "camera just inside min x misses a range");
+
+    // Fully outside, one direction per axis plus the sloped faces
+    Check(visible(0.0f, -40.0f, -8.0f) == (2u | 8u | 32u | sloped), "camera below every min sees the wrong ranges");
+    Check(visible(40.0f, 0.0f, 20.0f) == (1u | 4u | 16u | sloped), "camera above every max sees the wrong ranges");
+}
+
+static void CheckFaceRanges() {
+    const ChunkDrawList::FaceRanges ranges = { 10, 20, 30, 40, 50, 60, 70 };
+
+    // Everything visible is one draw
+    ChunkDrawList list;
+    list.AddFaceRanges(0, 1000, ranges, 0x7F, 0, 0, 0);
+    list.Build();
+    Check(list.Size() == 1 && SameCommand(list.GetCommands()[0], 280, 1000, 0), "visible ranges weren't merged");
+    Check(list.GetCulledVertexCount() == 0, "culled vertices with every range visible");
+
+    // Culling +Y and +Z leaves three runs of adjacent visible ranges
+    list.Clear();
+    list.AddFaceRanges(0, 1000, ranges, 0x7F & ~(4u | 16u), 0, 0, 0);
+    list.Build();
+    const auto& commands = list.GetCommands();
+    Check(list.Size() == 3, "culled ranges didn't split the draw in three");
+    if (list.Size() == 3) {
+        Check(SameCommand(commands[0], 30, 1000, 0), "first run wrong");
+        Check(SameCommand(commands[1], 40, 1060, 1), "second run wrong");
+        Check(SameCommand(commands[2], 130, 1150, 2), "last run wrong");
+    }
+    Check(list.GetCulledVertexCount() == 80 && list.GetVertexCount() == 200, "culled vertices don't add up");
+
+    // Nothing visible but the sloped faces, counted across calls until Clear
+    list.AddFaceRanges(1, 0, ranges, 1u << ChunkDrawList::SLOPED_FACE_RANGE, 0, 0, 0);
+    list.Build();
+    Check(list.Size() == 4 && SameCommand(list.GetCommands()[3], 70, 210, 3), "sloped range drawn wrong");
+    Check(list.GetCulledVertexCount() == 80 + 210, "culled vertices don't carry over until Clear");
+
+    // An empty culled range between two visible ones doesn't split them
+    const ChunkDrawList::FaceRanges gap = { 10, 0, 30, 0, 0, 0, 0 };
+    list.Clear();
+    list.AddFaceRanges(0, 0, gap, 1u | 4u, 0, 0, 0);
+    list.Build();
+    Check(list.Size() == 1 && SameCommand(list.GetCommands()[0], 40, 0, 0), "empty culled range split the draw");
+}
+
+int main() {
+    CheckBuild();
+    CheckVisibleFaceRanges();
+    CheckFaceRanges();
+
+    if (failures == 0)
+        std::cout << "Draw lists and face ranges build as expected" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
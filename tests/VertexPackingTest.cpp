@@ -0,0 +1,68 @@
+// Round trips VertexPacking at both chunk sizes and checks the normal table maps
+// back onto itself. Exits with 1 if anything failed.
+#include <iostream>
+
+#include "Block.h"
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what, int chunkSize, int detail) {
+    if (condition)
+        return;
+    std::cerr << "Chunk size " << chunkSize << ": " << what << " (" << detail << ")" << std::endl;
+    failures++;
+}
+
+static bool SameVertex(const VertexData& a, const VertexData& b) {
+    return a.pos.x == b.pos.x && a.pos.y == b.pos.y && a.pos.z == b.pos.z &&
+        a.tex.x == b.tex.x && a.tex.y == b.tex.y && a.textureIndex == b.textureIndex &&
+        VertexData::GetNormalIndex(a.norm) == VertexData::GetNormalIndex(b.norm);
+}
+
+static void CheckNormalTable() {
+    for (int i = 0; i < VertexData::NORMAL_COUNT; i++)
+        Check(VertexData::GetNormalIndex(VertexData::GetTableNormal(i)) == i, "normal table entry doesn't map back", 0, i);
+}
+
+template <int ChunkSize>
+static void CheckRoundTrip() {
+    using Packing = VertexPacking<ChunkSize>;
+
+    // Every corner position, heights in eighths
+    for (int y8 = 0; y8 <= 8 * ChunkSize; y8++) {
+        for (int z = 0; z <= ChunkSize; z++) {
+            for (int x = 0; x <= ChunkSize; x++) {
+                VertexData vertex(glm::vec3((float)x, y8 / 8.0f, (float)z), glm::vec2(0.0f, 0.0f), 0, glm::vec3(0.0f, 1.0f, 0.0f));
+                uint32_t packed = Packing::Pack(vertex);
+                Check(SameVertex(Packing::Unpack(packed), vertex), "position doesn't round trip", ChunkSize, (int)packed);
+            }
+        }
+    }
+
+    // Every texture coordinate, texture and normal, at the far corner so the
+    // attributes sit under the largest position
+    glm::vec3 corner((float)ChunkSize, (float)ChunkSize, (float)ChunkSize);
+    for (int u = 0; u <= 1; u++) {
+        for (int v8 = 0; v8 <= 8; v8++) {
+            for (int texture = 0; texture < VertexData::TEXTURE_COUNT; texture++) {
+                for (int normal = 0; normal < VertexData::NORMAL_COUNT; normal++) {
+                    VertexData vertex(corner, glm::vec2((float)u, v8 / 8.0f), texture, VertexData::GetTableNormal(normal));
+                    uint32_t packed = Packing::Pack(vertex);
+                    VertexData unpacked = Packing::Unpack(packed);
+                    Check(SameVertex(unpacked, vertex), "attributes don't round trip", ChunkSize, (int)packed);
+                    Check(Packing::Pack(unpacked) == packed, "repacking changes the vertex", ChunkSize, (int)packed);
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    CheckNormalTable();
+    CheckRoundTrip<16>();
+    CheckRoundTrip<32>();
+
+    if (failures == 0)
+        std::cout << "Vertex packing round trips at chunk sizes 16 and 32" << std::endl;
+    return failures == 0 ? 0 : 1;
+}